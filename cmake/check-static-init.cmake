@@ -0,0 +1,49 @@
+# Fails if any object in LIBRARY (a static library) needs code to run at load time:
+# a _GLOBAL__sub_I_* function (dynamic initialization of a global) or a non-empty
+# .init_array/.ctors section. Run with
+#   cmake -DNM=<nm> -DOBJDUMP=<objdump> -DLIBRARY=<library> -P check-static-init.cmake
+
+if (NOT NM OR NOT OBJDUMP OR NOT LIBRARY)
+  message(FATAL_ERROR "NM, OBJDUMP and LIBRARY must be set")
+endif ()
+
+execute_process(COMMAND "${NM}" -A "${LIBRARY}"
+  OUTPUT_VARIABLE symbols
+  RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "Could not list the symbols in ${LIBRARY}")
+endif ()
+
+set(failures "")
+
+string(REGEX MATCHALL "[^\n]*_GLOBAL__sub_I_[^\n]*" initializers "${symbols}")
+foreach (initializer IN LISTS initializers)
+  string(APPEND failures "  dynamic initializer: ${initializer}\n")
+endforeach ()
+
+execute_process(COMMAND "${OBJDUMP}" -h "${LIBRARY}"
+  OUTPUT_VARIABLE sections
+  RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+  message(FATAL_ERROR "Could not list the sections in ${LIBRARY}")
+endif ()
+
+# objdump prints "<member>:     file format ..." before each object's section table
+string(REPLACE "\n" ";" lines "${sections}")
+set(member "")
+foreach (line IN LISTS lines)
+  if (line MATCHES "^([^ ]+):[ \t]+file format")
+    set(member "${CMAKE_MATCH_1}")
+  elseif (line MATCHES "^[ \t]*[0-9]+[ \t]+(\\.init_array|\\.ctors)[^ \t]*[ \t]+([0-9a-fA-F]+)")
+    set(section "${CMAKE_MATCH_1}")
+    if (NOT CMAKE_MATCH_2 MATCHES "^0+$")
+      string(APPEND failures "  ${section} section in ${member}\n")
+    endif ()
+  endif ()
+endforeach ()
+
+if (failures)
+  message(FATAL_ERROR "${LIBRARY} runs code at load time:\n${failures}")
+endif ()
+
+message(STATUS "No dynamic initializers in ${LIBRARY}")
@@ -0,0 +1,192 @@
+#include "joytime-core-basic.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+
+/*
+ * Fuzzes report decoding and calibration parsing. The input is a list of packets, each
+ * a 2-byte little endian length followed by that many bytes. The first
+ * `Controller::calibrationReadCount` packets are the SPI flash contents `initialize`
+ * reads for calibration (so they end up in `applyCalibration`); the rest are reports,
+ * decoded by `Controller::poll`.
+ *
+ * The standard input reports among them are also decoded by a second Controller and by a
+ * `BasicController<Pro, ...>`, with the same calibration, and the two states have to match.
+ */
+
+namespace {
+  // answers every subcommand straight away, then hands out `reports` once they're enabled
+  class FuzzTransport: public Joytime::Transport {
+    private:
+      std::deque<std::vector<uint8_t>> pending;
+      size_t nextRead = 0;
+    public:
+      const std::vector<std::vector<uint8_t>>* flash = nullptr;
+      std::deque<std::vector<uint8_t>> reports;
+      bool reportsEnabled = false;
+      // called with every packet `receive` returns
+      std::function<void(const uint8_t*, size_t)> observer;
+
+      int send(const uint8_t* data, size_t size) override {
+        if (size < 11 || data[0] != (uint8_t)Joytime::ControllerCommand::RumbleAndSubcommand) return size;
+
+        std::vector<uint8_t> reply(20, 0);
+        reply[0] = (uint8_t)Joytime::ControllerReportCode::SubcommandReply;
+        reply[13] = 0x80;
+        reply[14] = data[10];
+
+        if (data[10] == (uint8_t)Joytime::ControllerSubcommand::ReadSPIFlash && size >= 16) {
+          memcpy(reply.data() + 15, data + 11, 5);
+          if (flash != nullptr && nextRead < flash->size()) {
+            const std::vector<uint8_t>& contents = (*flash)[nextRead++];
+            reply.insert(reply.end(), contents.begin(), contents.end());
+          }
+        }
+
+        pending.push_back(reply);
+        return size;
+      };
+
+      int receive(uint8_t* data, size_t capacity, int) override {
+        std::deque<std::vector<uint8_t>>& source = (!pending.empty() || !reportsEnabled) ? pending : reports;
+        if (source.empty()) return 0;
+
+        std::vector<uint8_t> packet = std::move(source.front());
+        source.pop_front();
+
+        size_t size = std::min(packet.size(), capacity);
+        memcpy(data, packet.data(), size);
+        if (observer) observer(data, size);
+        return size;
+      };
+
+      bool idle() const {
+        return pending.empty() && (!reportsEnabled || reports.empty());
+      };
+  };
+
+  struct NullTransport {
+    int send(const uint8_t*, size_t size) {
+      return size;
+    };
+    int receive(uint8_t*, size_t, int) {
+      return 0;
+    };
+  };
+
+  bool isStandardReport(const std::vector<uint8_t>& report) {
+    switch (report[0]) {
+      case (uint8_t)Joytime::ControllerReportCode::SubcommandReply:
+      case (uint8_t)Joytime::ControllerReportCode::Standard:
+      case (uint8_t)Joytime::ControllerReportCode::NFCIR:
+        return true;
+      default:
+        return false;
+    }
+  };
+
+  // bit for bit, so NaNs from a degenerate calibration compare equal too
+  bool same(const Joytime::SixAxis& a, const Joytime::SixAxis& b) {
+    return memcmp(&a.x, &b.x, sizeof(double)) == 0 && memcmp(&a.y, &b.y, sizeof(double)) == 0 && memcmp(&a.z, &b.z, sizeof(double)) == 0;
+  };
+
+  void compare(const Joytime::ControllerState& controller, const Joytime::ControllerState& basic) {
+    const char* field = nullptr;
+
+    if (controller.sequence != basic.sequence) field = "sequence";
+    else if (controller.timer != basic.timer) field = "timer";
+    else if (controller.battery != basic.battery) field = "battery";
+    else if (Joytime::packButtons(controller.buttons) != Joytime::packButtons(basic.buttons)) field = "buttons";
+    else if (controller.leftStick.x != basic.leftStick.x || controller.leftStick.y != basic.leftStick.y) field = "leftStick";
+    else if (controller.rightStick.x != basic.rightStick.x || controller.rightStick.y != basic.rightStick.y) field = "rightStick";
+    else if (!same(controller.accelerometer, basic.accelerometer)) field = "accelerometer";
+    else if (!same(controller.gyroscope, basic.gyroscope)) field = "gyroscope";
+
+    if (field == nullptr) return;
+
+    fprintf(stderr, "Controller and BasicController decoded different %s (after %llu reports)\n", field, (unsigned long long)controller.sequence);
+    abort();
+  };
+
+  template <typename Calibrated>
+  void copyCalibration(Joytime::Controller& controller, const Calibrated& source) {
+    controller.leftStickCalibration = source.leftStickCalibration;
+    controller.rightStickCalibration = source.rightStickCalibration;
+    controller.accelerometerCalibration = source.accelerometerCalibration;
+    controller.gyroscopeCalibration = source.gyroscopeCalibration;
+  };
+
+  void drain(Joytime::Controller& controller, FuzzTransport& transport) {
+    transport.reportsEnabled = true;
+    while (!transport.idle()) controller.poll();
+  };
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  std::vector<std::vector<uint8_t>> flash;
+  std::deque<std::vector<uint8_t>> reports;
+
+  while (size >= 2) {
+    size_t length = std::min((size_t)(data[0] | (data[1] << 8)), size - 2);
+    data += 2;
+    size -= 2;
+
+    std::vector<uint8_t> packet(data, data + length);
+    data += length;
+    size -= length;
+
+    if (flash.size() < Joytime::Controller::calibrationReadCount) {
+      flash.push_back(std::move(packet));
+    } else if (!packet.empty()) {
+      // an empty packet is how a transport says nothing arrived
+      reports.push_back(std::move(packet));
+    }
+  }
+
+  FuzzTransport transport;
+  transport.flash = &flash;
+  for (const std::vector<uint8_t>& report: reports) transport.reports.push_back(report);
+
+  Joytime::Controller controller(Joytime::ControllerType::Pro, nullptr, &transport);
+  controller.subcommandTimeout = 1000;
+  controller.addMCUListener([](Joytime::Controller*, const Joytime::MCUReportView& report) {
+    // touch every byte, so reading past the report shows up
+    volatile uint8_t sum = 0;
+    for (size_t i = 0; i < report.size; i++) sum += report.data[i];
+  });
+  controller.initialize(true);
+  drain(controller, transport);
+
+  Joytime::SixAxisSample samples[16];
+  while (controller.readSixAxisSamples(samples, 16) > 0);
+
+  // the differential check. both decoders see every packet the second Controller
+  // receives, its subcommand replies included, and start out uncalibrated
+  FuzzTransport referenceTransport;
+  for (const std::vector<uint8_t>& report: reports) {
+    if (isStandardReport(report)) referenceTransport.reports.push_back(report);
+  }
+
+  Joytime::BasicController<Joytime::ControllerType::Pro, NullTransport> basic((NullTransport()));
+  referenceTransport.observer = [&basic](const uint8_t* buf, size_t size) {
+    basic.decode(buf, size);
+  };
+
+  Joytime::Controller reference(Joytime::ControllerType::Pro, nullptr, &referenceTransport);
+  reference.subcommandTimeout = 1000;
+  reference.initialize(false);
+  compare(reference.snapshot(), basic.state());
+
+  copyCalibration(reference, controller);
+  basic.calibrateFrom(controller);
+
+  referenceTransport.reportsEnabled = true;
+  while (!referenceTransport.idle()) {
+    reference.poll();
+    compare(reference.snapshot(), basic.state());
+  }
+
+  return 0;
+};
@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+/*
+ * Runs the fuzz harness without libFuzzer: over the files named on the command line,
+ * or, without any, over inputs generated from a fixed seed (mostly well-formed
+ * reports with a few bytes flipped, cut short or padded), so it can run as a test.
+ */
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static const size_t generatedInputs = 2000;
+// the six SPI flash reads done when calibrating, and how long they are
+static const size_t flashLengths[] = { 24, 9, 9, 6, 18, 18 };
+static const uint8_t reportCodes[] = { 0x21, 0x30, 0x31, 0x3f, 0x23, 0x00 };
+
+static void appendPacket(std::vector<uint8_t>& input, const std::vector<uint8_t>& packet) {
+  input.push_back(packet.size() & 0xff);
+  input.push_back(packet.size() >> 8);
+  input.insert(input.end(), packet.begin(), packet.end());
+};
+
+static std::vector<uint8_t> generateInput(std::mt19937& random) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> percent(0, 99);
+  std::vector<uint8_t> input;
+
+  for (size_t length: flashLengths) {
+    // sometimes shorter or longer than asked for
+    if (percent(random) < 10) length = std::uniform_int_distribution<size_t>(0, 40)(random);
+
+    std::vector<uint8_t> packet(length);
+    for (uint8_t& b: packet) b = byte(random);
+    appendPacket(input, packet);
+  }
+
+  size_t reports = std::uniform_int_distribution<size_t>(0, 24)(random);
+  for (size_t i = 0; i < reports; i++) {
+    uint8_t code = reportCodes[std::uniform_int_distribution<size_t>(0, sizeof(reportCodes) - 1)(random)];
+    size_t length = (code == 0x31) ? 362 : (code == 0x3f) ? 12 : 49;
+    if (percent(random) < 30) length = std::uniform_int_distribution<size_t>(1, length)(random);
+
+    std::vector<uint8_t> packet(length);
+    for (uint8_t& b: packet) b = byte(random);
+    packet[0] = code;
+    appendPacket(input, packet);
+  }
+
+  // flip a few bytes anywhere, length prefixes included
+  size_t flips = (percent(random) < 20) ? std::uniform_int_distribution<size_t>(1, 4)(random) : 0;
+  for (size_t i = 0; i < flips && !input.empty(); i++) {
+    input[std::uniform_int_distribution<size_t>(0, input.size() - 1)(random)] ^= 1 << std::uniform_int_distribution<int>(0, 7)(random);
+  }
+
+  return input;
+};
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      std::ifstream file(argv[i], std::ios::binary);
+      if (!file) {
+        fprintf(stderr, "Could not open %s\n", argv[i]);
+        return 1;
+      }
+
+      std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+      LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+
+    printf("Ran %d inputs\n", argc - 1);
+    return 0;
+  }
+
+  std::mt19937 random(0x4a6f79);
+  for (size_t i = 0; i < generatedInputs; i++) {
+    std::vector<uint8_t> input = generateInput(random);
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+
+  printf("Ran %zu generated inputs\n", generatedInputs);
+  return 0;
+};
@@ -0,0 +1,334 @@
+#ifndef JOYTIME_CORE_ASYNC_HPP
+#define JOYTIME_CORE_ASYNC_HPP
+
+#include "joytime-core.hpp"
+
+/*
+ * C++20 coroutine versions of the Controller operations, built on top of the
+ * callback-based `...Async` methods. The library itself is still built as C++17;
+ * only the code including this header needs C++20.
+ *
+ * One Executor (and one thread) can drive any number of controllers at once:
+ *
+ *   Joytime::Async::Executor executor;
+ *   for (Joytime::Controller& controller: controllers) {
+ *     executor.spawn(setUp(executor, controller));
+ *   }
+ *   executor.run();
+ *
+ * where `setUp` is a coroutine returning `Joytime::Async::Task<>` that does, for example:
+ *
+ *   co_await Joytime::Async::initialize(executor, controller, true);
+ *   co_await Joytime::Async::setLEDs(executor, controller, ...);
+ */
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <algorithm>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Joytime {
+  namespace Async {
+    template <typename T = void> class Task;
+
+    namespace detail {
+      struct PromiseBase {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr exception;
+
+        struct FinalAwaiter {
+          bool await_ready() noexcept { return false; }
+          template <typename Promise>
+          std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            // hand control back to whoever was awaiting this task
+            if (handle.promise().continuation) return handle.promise().continuation;
+            return std::noop_coroutine();
+          }
+          void await_resume() noexcept {}
+        };
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        FinalAwaiter final_suspend() noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+      };
+
+      template <typename T>
+      struct Promise: PromiseBase {
+        std::optional<T> value;
+
+        Task<T> get_return_object();
+        void return_value(T _value) { value = std::move(_value); }
+      };
+
+      template <>
+      struct Promise<void>: PromiseBase {
+        Task<void> get_return_object();
+        void return_void() {}
+      };
+
+      // a fire-and-forget coroutine, used to run spawned tasks
+      struct Detached {
+        struct promise_type {
+          Detached get_return_object() { return {}; }
+          std::suspend_never initial_suspend() noexcept { return {}; }
+          std::suspend_never final_suspend() noexcept { return {}; }
+          void return_void() {}
+          void unhandled_exception() { std::terminate(); }
+        };
+      };
+    };
+
+    /*
+     * A lazily-started coroutine returning a T. It starts running when it's awaited
+     * (or spawned on an Executor), and rethrows any exception it threw when awaited.
+     */
+    template <typename T>
+    class Task {
+      public:
+        using promise_type = detail::Promise<T>;
+
+        Task(Task&& other) noexcept:
+          handle(std::exchange(other.handle, {})) {};
+        Task& operator=(Task&& other) noexcept {
+          if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+          }
+          return *this;
+        };
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+        ~Task() {
+          if (handle) handle.destroy();
+        };
+
+        bool await_ready() const noexcept {
+          return !handle || handle.done();
+        };
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+          handle.promise().continuation = awaiting;
+          return handle;
+        };
+        T await_resume() {
+          promise_type& promise = handle.promise();
+          if (promise.exception) std::rethrow_exception(promise.exception);
+          if constexpr (!std::is_void_v<T>) return std::move(*promise.value);
+        };
+      private:
+        friend struct detail::Promise<T>;
+
+        explicit Task(std::coroutine_handle<promise_type> _handle):
+          handle(_handle) {};
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template <typename T>
+    inline Task<T> detail::Promise<T>::get_return_object() {
+      return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+    };
+
+    inline Task<void> detail::Promise<void>::get_return_object() {
+      return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+    };
+
+    /*
+     * Resumes coroutines and polls the controllers they're waiting on, all on the
+     * thread calling `run` (or `runOnce`). Controllers are watched automatically
+     * when an operation is started on them.
+     */
+    class Executor {
+      private:
+        std::mutex mutex;
+        std::deque<std::coroutine_handle<>> ready;
+        std::vector<Controller*> controllers;
+        size_t running = 0;
+
+        static detail::Detached drive(Executor* executor, Task<void> task, std::function<void(std::exception_ptr)> done) {
+          co_await executor->schedule();
+
+          std::exception_ptr error;
+          try {
+            co_await std::move(task);
+          } catch (...) {
+            error = std::current_exception();
+          }
+
+          {
+            std::lock_guard<std::mutex> lock(executor->mutex);
+            executor->running--;
+          }
+          if (done) done(error);
+        };
+      public:
+        struct ScheduleAwaiter {
+          Executor* executor;
+
+          bool await_ready() const noexcept { return false; }
+          void await_suspend(std::coroutine_handle<> handle) { executor->post(handle); }
+          void await_resume() const noexcept {}
+        };
+
+        // queues a coroutine to be resumed on the executor's thread. thread-safe
+        void post(std::coroutine_handle<> handle) {
+          std::lock_guard<std::mutex> lock(mutex);
+          ready.push_back(handle);
+        };
+
+        // `co_await executor.schedule()` continues on the executor's thread
+        ScheduleAwaiter schedule() {
+          return ScheduleAwaiter { this };
+        };
+
+        void watch(Controller* controller) {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (std::find(controllers.begin(), controllers.end(), controller) == controllers.end()) controllers.push_back(controller);
+        };
+        void unwatch(Controller* controller) {
+          std::lock_guard<std::mutex> lock(mutex);
+          controllers.erase(std::remove(controllers.begin(), controllers.end(), controller), controllers.end());
+        };
+
+        // starts a task. `done`, if set, is called with the exception it threw (or nullptr)
+        // once it finishes. a failing task doesn't affect any of the others
+        void spawn(Task<void> task, std::function<void(std::exception_ptr)> done = nullptr) {
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            running++;
+          }
+          drive(this, std::move(task), std::move(done));
+        };
+
+        // resumes everything that's ready and polls the watched controllers once.
+        // if there was nothing to do, sleeps for up to `timeout` milliseconds.
+        // returns whether any spawned tasks are still running
+        bool runOnce(int timeout = 1) {
+          std::deque<std::coroutine_handle<>> resumable;
+          std::vector<Controller*> polled;
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            resumable.swap(ready);
+            polled = controllers;
+          }
+
+          for (std::coroutine_handle<> handle: resumable) handle.resume();
+
+          size_t reports = 0;
+          for (Controller* controller: polled) {
+            if (controller->isUsable()) reports += controller->poll(0);
+          }
+
+          std::lock_guard<std::mutex> lock(mutex);
+          if (resumable.empty() && reports == 0 && ready.empty() && timeout > 0) {
+            mutex.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+            mutex.lock();
+          }
+          return running > 0 || !ready.empty();
+        };
+
+        // runs until every spawned task has finished
+        void run() {
+          while (runOnce());
+        };
+    };
+
+    /*
+     * Awaits one of the Controller's callback-based operations. The callback
+     * resumes the awaiting coroutine on the executor.
+     */
+    template <typename Result>
+    class Operation {
+      private:
+        Executor* executor;
+        std::function<void(std::function<void(std::optional<Result>)>)> start;
+        std::optional<Result> result;
+      public:
+        Operation(Executor* _executor, std::function<void(std::function<void(std::optional<Result>)>)> _start):
+          executor(_executor),
+          start(std::move(_start)) {};
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) {
+          start([this, handle](std::optional<Result> _result) {
+            result = std::move(_result);
+            executor->post(handle);
+          });
+        };
+        Result await_resume() {
+          if (!result) throw std::runtime_error("Controller operation failed: no reply was received.");
+          return std::move(*result);
+        };
+    };
+
+    // wraps an operation that only reports success or failure
+    inline Operation<bool> completion(Executor& executor, Controller& controller, std::function<void(CompletionCallback)> start) {
+      executor.watch(&controller);
+      return Operation<bool>(&executor, [start](std::function<void(std::optional<bool>)> resume) {
+        start([resume](Controller*, bool success) {
+          resume(success ? std::optional<bool>(true) : std::nullopt);
+        });
+      });
+    };
+
+    inline Operation<bool> initialize(Executor& executor, Controller& controller, bool calibrate = false) {
+      return completion(executor, controller, [&controller, calibrate](CompletionCallback callback) {
+        controller.initializeAsync(calibrate, callback);
+      });
+    };
+
+    inline Operation<bool> setVibration(Executor& executor, Controller& controller, bool vibrate) {
+      return completion(executor, controller, [&controller, vibrate](CompletionCallback callback) {
+        controller.setVibrationAsync(vibrate, callback);
+      });
+    };
+
+    inline Operation<bool> setSixAxisEnabled(Executor& executor, Controller& controller, bool enabled) {
+      return completion(executor, controller, [&controller, enabled](CompletionCallback callback) {
+        controller.setSixAxisEnabledAsync(enabled, callback);
+      });
+    };
+
+    inline Operation<bool> setInputReportMode(Executor& executor, Controller& controller, ControllerInputReportMode mode) {
+      return completion(executor, controller, [&controller, mode](CompletionCallback callback) {
+        controller.setInputReportModeAsync(mode, callback);
+      });
+    };
+
+    inline Operation<bool> setLEDs(Executor& executor, Controller& controller, ControllerLEDState led1, ControllerLEDState led2, ControllerLEDState led3, ControllerLEDState led4) {
+      return completion(executor, controller, [&controller, led1, led2, led3, led4](CompletionCallback callback) {
+        controller.setLEDsAsync(led1, led2, led3, led4, callback);
+      });
+    };
+
+    inline Operation<bool> setPowerState(Executor& executor, Controller& controller, ControllerPowerState state) {
+      return completion(executor, controller, [&controller, state](CompletionCallback callback) {
+        controller.setPowerStateAsync(state, callback);
+      });
+    };
+
+    inline Operation<std::vector<uint8_t>> readSPIFlash(Executor& executor, Controller& controller, int32_t address, uint8_t length) {
+      executor.watch(&controller);
+      return Operation<std::vector<uint8_t>>(&executor, [&controller, address, length](std::function<void(std::optional<std::vector<uint8_t>>)> resume) {
+        controller.readSPIFlashAsync(address, length, [resume](Controller*, const uint8_t* data, size_t size) {
+          if (data == nullptr) return resume(std::nullopt);
+          resume(std::vector<uint8_t>(data, data + size));
+        });
+      });
+    };
+  };
+};
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* JOYTIME_CORE_ASYNC_HPP */
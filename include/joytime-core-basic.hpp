@@ -0,0 +1,287 @@
+#ifndef JOYTIME_CORE_BASIC_HPP
+#define JOYTIME_CORE_BASIC_HPP
+
+#include "joytime-core.hpp"
+
+/*
+ * A header-only controller whose type and transport are fixed at compile time,
+ * so input decoding and transport calls can be inlined into the app:
+ *
+ *   Joytime::BasicController<Joytime::ControllerType::Pro, HIDTransport> pro(HIDTransport(device));
+ *   pro.calibrateFrom(controller); // an initialized Joytime::Controller
+ *   while (running) {
+ *     pro.poll(5);
+ *     use(pro.state());
+ *   }
+ *
+ * Build with the JOYTIME_CORE_HEADER_ONLY CMake option to get the
+ * `joytime-core_header` target, which needs nothing to be linked as long as only
+ * the compile-time parts of the library (BasicController, EncodedRumble, the
+ * pre-encoded Rumble constructor) are used.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace Joytime {
+  namespace detail {
+    // bytes needed for the buttons and sticks, and for the first six-axis sample
+    constexpr size_t inputReportSize = 12;
+    constexpr size_t sixAxisReportSize = 25;
+    // standard reports carry three six-axis samples, from byte 13 on
+    constexpr size_t sixAxisSampleOffset = 13;
+    constexpr size_t sixAxisSampleSize = 12;
+    constexpr size_t sixAxisSampleCount = 3;
+    constexpr size_t standardReportSize = sixAxisSampleOffset + sixAxisSampleSize * sixAxisSampleCount;
+
+    // decodes the six-axis sample starting at `sample`
+    template <typename Calibrated>
+    inline void decodeSixAxisSample(const uint8_t* sample, const Calibrated& calibration, SixAxis& accelerometer, SixAxis& gyroscope) {
+      const SixAxisCalibrationData& accelerometerCalibration = calibration.accelerometerCalibration;
+      const SixAxisCalibrationData& gyroscopeCalibration = calibration.gyroscopeCalibration;
+
+      int16_t rawAccelX = (sample[1] << 8) | sample[0];
+      int16_t rawAccelY = (sample[3] << 8) | sample[2];
+      int16_t rawAccelZ = (sample[5] << 8) | sample[4];
+      int16_t rawGyroX = (sample[7] << 8) | sample[6];
+      int16_t rawGyroY = (sample[9] << 8) | sample[8];
+      int16_t rawGyroZ = (sample[11] << 8) | sample[10];
+
+      accelerometer.x = (rawAccelX - accelerometerCalibration.offsetX) * accelerometerCalibration.coeffX;
+      accelerometer.y = (rawAccelY - accelerometerCalibration.offsetY) * accelerometerCalibration.coeffY;
+      accelerometer.z = (rawAccelZ - accelerometerCalibration.offsetZ) * accelerometerCalibration.coeffZ;
+
+      gyroscope.x = rawGyroX * gyroscopeCalibration.coeffX;
+      gyroscope.y = rawGyroY * gyroscopeCalibration.coeffY;
+      gyroscope.z = rawGyroZ * gyroscopeCalibration.coeffZ;
+    };
+
+    /*
+     * Decodes a standard input report (0x21, 0x30 or 0x31) into `state`, skipping
+     * whatever a controller of type `Type` doesn't have. `calibration` is anything
+     * with Controller's `...Calibration` fields.
+     *
+     * Truncated reports are decoded as far as they go; nothing past `size` is read.
+     */
+    template <ControllerType Type, typename Calibrated>
+    inline void decodeInputReport(const uint8_t* buf, size_t size, const Calibrated& calibration, ControllerState& state) {
+      constexpr bool hasLeft = Type != ControllerType::RightJoycon;
+      constexpr bool hasRight = Type != ControllerType::LeftJoycon;
+
+      if (size < 2) return;
+      state.timer = buf[1];
+      if (size < inputReportSize) return;
+
+      switch (buf[0]) {
+        case (uint8_t)ControllerReportCode::NFCIR:
+          // no break; the packet also contains a standard input report
+        case (uint8_t)ControllerReportCode::SubcommandReply:
+          // no break; the packet also (partially) contains a standard input report
+        case (uint8_t)ControllerReportCode::Standard:
+          uint8_t _battery = (buf[2] & 0xf0) >> 4;
+          if (_battery & 0x01) {
+            state.battery = ControllerBatteryStatus::Charging;
+          } else {
+            state.battery = (ControllerBatteryStatus)_battery;
+          }
+
+          uint8_t sideButtons = 0;
+
+          if constexpr (hasRight) {
+            state.buttons.a = buf[3] & 0x08;
+            state.buttons.b = buf[3] & 0x04;
+            state.buttons.x = buf[3] & 0x02;
+            state.buttons.y = buf[3] & 0x01;
+
+            state.buttons.r = buf[3] & 0x40;
+            state.buttons.zr = buf[3] & 0x80;
+
+            sideButtons |= buf[3];
+          }
+
+          if constexpr (hasLeft) {
+            state.buttons.up = buf[5] & 0x02;
+            state.buttons.down = buf[5] & 0x01;
+            state.buttons.left = buf[5] & 0x08;
+            state.buttons.right = buf[5] & 0x04;
+
+            state.buttons.l = buf[5] & 0x40;
+            state.buttons.zl = buf[5] & 0x80;
+
+            sideButtons |= buf[5];
+          }
+
+          state.buttons.sl = sideButtons & 0x20;
+          state.buttons.sr = sideButtons & 0x10;
+
+          state.buttons.plus = buf[4] & 0x02;
+          state.buttons.minus = buf[4] & 0x01;
+
+          state.buttons.lStick = buf[4] & 0x08;
+          state.buttons.rStick = buf[4] & 0x04;
+
+          state.buttons.home = buf[4] & 0x10;
+          state.buttons.capture = buf[4] & 0x20;
+
+          if constexpr (hasLeft) {
+            int16_t rawLeftX = (((buf[7] & 0xf) << 8) | buf[6]);
+            int16_t rawLeftY = ((buf[8] << 4) | (buf[7] >> 4));
+
+            state.leftStick.x = rawLeftX - calibration.leftStickCalibration.xCenter;
+            state.leftStick.y = rawLeftY - calibration.leftStickCalibration.yCenter;
+          }
+
+          if constexpr (hasRight) {
+            int16_t rawRightX = (((buf[10] & 0xf) << 8) | buf[9]);
+            int16_t rawRightY = ((buf[11] << 4) | (buf[10] >> 4));
+
+            state.rightStick.x = rawRightX - calibration.rightStickCalibration.xCenter;
+            state.rightStick.y = rawRightY - calibration.rightStickCalibration.yCenter;
+          }
+
+          if (buf[0] != (uint8_t)ControllerReportCode::SubcommandReply && size >= sixAxisReportSize) {
+            decodeSixAxisSample(buf + sixAxisSampleOffset, calibration, state.accelerometer, state.gyroscope);
+          }
+
+          break;
+      }
+    };
+  };
+
+  /*
+   * `TransportT` is any type with Transport's `send` and `receive` (it doesn't have
+   * to derive from Transport); it's stored by value and called directly.
+   *
+   * This only covers the steady state: decoding standard input reports and sending
+   * rumbles and subcommands, without waiting for replies. Initialize the controller
+   * (or at least read its calibration) with a Controller first, and hand the
+   * calibration over with `calibrateFrom`.
+   *
+   * Not thread safe, and rumbles aren't paced like Controller's.
+   */
+  template <ControllerType Type, typename TransportT>
+  class BasicController {
+    private:
+      TransportT transport_;
+      ControllerState state_;
+      uint8_t counter = 0;
+
+      void send(const uint8_t* buf, size_t size) {
+        if (transport_.send(buf, size) < 0) throw std::runtime_error("Could not send command: the transport failed to send it.");
+      };
+    public:
+      static constexpr ControllerType type = Type;
+
+      StickCalibrationData leftStickCalibration;
+      StickCalibrationData rightStickCalibration;
+      SixAxisCalibrationData accelerometerCalibration;
+      SixAxisCalibrationData gyroscopeCalibration;
+
+      explicit BasicController(TransportT transport):
+        transport_(std::move(transport)) {};
+
+      TransportT& transport() {
+        return transport_;
+      };
+      const ControllerState& state() const {
+        return state_;
+      };
+
+      // copies the calibration from anything that has it, e.g. an initialized Controller
+      template <typename Calibrated>
+      void calibrateFrom(const Calibrated& source) {
+        leftStickCalibration = source.leftStickCalibration;
+        rightStickCalibration = source.rightStickCalibration;
+        accelerometerCalibration = source.accelerometerCalibration;
+        gyroscopeCalibration = source.gyroscopeCalibration;
+      };
+
+      // decodes one report. returns false (and leaves the state alone) if it isn't a standard input report
+      bool decode(const uint8_t* buf, size_t size) {
+        if (size < 1) return false;
+
+        switch (buf[0]) {
+          case (uint8_t)ControllerReportCode::SubcommandReply:
+          case (uint8_t)ControllerReportCode::Standard:
+          case (uint8_t)ControllerReportCode::NFCIR:
+            detail::decodeInputReport<Type>(buf, size, *this, state_);
+            state_.sequence++;
+            return true;
+          default:
+            return false;
+        }
+      };
+
+      // receives and decodes every report that's available, waiting at most `timeout`
+      // milliseconds for the first one. returns the number of reports received
+      size_t poll(int timeout = 0) {
+        uint8_t buf[Transport::maxPacketSize];
+        size_t received = 0;
+
+        while (received < ReportQueue::maxBatchSize) {
+          int size = transport_.receive(buf, sizeof(buf), (received == 0) ? timeout : 0);
+          if (size < 0) throw std::runtime_error("Could not receive reports: the transport failed to receive them.");
+          if (size == 0) break;
+
+          decode(buf, size);
+          received++;
+        }
+
+        return received;
+      };
+
+      // the same rumble on every side this controller has
+      void rumble(uint8_t timing, const Rumble& rumble) {
+        EncodedRumble frame = rumble.encoded();
+
+        if constexpr (Type == ControllerType::LeftJoycon) {
+          rumbleEncoded(timing, frame, neutralRumbleEncoded);
+        } else if constexpr (Type == ControllerType::RightJoycon) {
+          rumbleEncoded(timing, neutralRumbleEncoded, frame);
+        } else {
+          rumbleEncoded(timing, frame, frame);
+        }
+      };
+      void rumble(uint8_t timing, const Rumble& leftRumble, const Rumble& rightRumble) {
+        rumbleEncoded(timing, leftRumble.encoded(), rightRumble.encoded());
+      };
+      void rumbleEncoded(uint8_t timing, const EncodedRumble& leftFrame, const EncodedRumble& rightFrame) {
+        uint8_t buf[10] = { (uint8_t)ControllerCommand::SendRumble, timing };
+
+        memcpy(buf + 2, leftFrame.data(), 4);
+        memcpy(buf + 6, rightFrame.data(), 4);
+
+        send(buf, sizeof(buf));
+      };
+
+      // sends a subcommand without waiting for its reply (it's decoded by `poll` like any other report)
+      void sendSubcommand(ControllerSubcommand subcommand, const uint8_t* data, size_t size) {
+        uint8_t buf[Transport::maxPacketSize];
+        size = std::min(size, sizeof(buf) - 11);
+
+        buf[0] = (uint8_t)ControllerCommand::RumbleAndSubcommand;
+        buf[1] = counter++ & 0xf;
+
+        memcpy(buf + 2, neutralRumbleEncoded.data(), 4);
+        memcpy(buf + 6, neutralRumbleEncoded.data(), 4);
+
+        buf[10] = (uint8_t)subcommand;
+
+        if (size > 0) memcpy(buf + 11, data, size);
+
+        send(buf, size + 11);
+      };
+      void setInputReportMode(ControllerInputReportMode reportMode = ControllerInputReportMode::StandardReport) {
+        uint8_t buf[] = { (uint8_t)reportMode };
+        sendSubcommand(ControllerSubcommand::SetInputReportMode, buf, sizeof(buf));
+      };
+      void setSixAxisEnabled(bool sixAxis) {
+        uint8_t buf[] = { (uint8_t)(sixAxis ? 1 : 0) };
+        sendSubcommand(ControllerSubcommand::SetSixAxisSensor, buf, sizeof(buf));
+      };
+  };
+};
+
+#endif /* JOYTIME_CORE_BASIC_HPP */
@@ -1,6 +1,7 @@
 #ifndef JOYTIME_CORE_H
 #define JOYTIME_CORE_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include "joytime_core_EXPORTS.h"
@@ -122,10 +123,104 @@ typedef void (Joytime_UpdateListener)(Joytime_Controller*);
 typedef void (Joytime_TransmitBufferFunction)(void*, uint8_t*, int);
 typedef uint8_t* (Joytime_ReceiveBufferFunction)(void*, int, int*);
 
+typedef struct _Joytime_PacketView {
+  uint8_t* data;
+  size_t size;
+} Joytime_PacketView;
+
+typedef struct _Joytime_ConstPacketView {
+  const uint8_t* data;
+  size_t size;
+} Joytime_ConstPacketView;
+
+/*
+ * A table of functions implementing a transport (the C counterpart of Joytime::Transport).
+ * `send` and `receive` are required; everything else may be NULL, in which case
+ * the default behavior is used (batches fall back to single calls, FDs are -1).
+ * `userData` is passed as the first argument to every function.
+ * Joytime_Controller_newWithTransport returns NULL if the table or either required function is NULL.
+ */
+typedef struct _Joytime_Transport {
+  void* userData;
+  int (*send)(void* userData, const uint8_t* data, size_t size);
+  int (*receive)(void* userData, uint8_t* data, size_t capacity, int timeout);
+  size_t (*sendBatch)(void* userData, const Joytime_ConstPacketView* packets, size_t count);
+  size_t (*receiveBatch)(void* userData, Joytime_PacketView* packets, size_t count, int timeout);
+  int (*readFD)(void* userData);
+  int (*writeFD)(void* userData);
+  /* called when the controller using the transport is freed; may be NULL */
+  void (*destroy)(void* userData);
+} Joytime_Transport;
+
+/* bits of Joytime_ControllerState.buttons */
+#define JOYTIME_BUTTON_A (1u << 0)
+#define JOYTIME_BUTTON_B (1u << 1)
+#define JOYTIME_BUTTON_X (1u << 2)
+#define JOYTIME_BUTTON_Y (1u << 3)
+#define JOYTIME_BUTTON_UP (1u << 4)
+#define JOYTIME_BUTTON_DOWN (1u << 5)
+#define JOYTIME_BUTTON_LEFT (1u << 6)
+#define JOYTIME_BUTTON_RIGHT (1u << 7)
+#define JOYTIME_BUTTON_L (1u << 8)
+#define JOYTIME_BUTTON_R (1u << 9)
+#define JOYTIME_BUTTON_ZL (1u << 10)
+#define JOYTIME_BUTTON_ZR (1u << 11)
+#define JOYTIME_BUTTON_SL (1u << 12)
+#define JOYTIME_BUTTON_SR (1u << 13)
+#define JOYTIME_BUTTON_PLUS (1u << 14)
+#define JOYTIME_BUTTON_MINUS (1u << 15)
+#define JOYTIME_BUTTON_LSTICK (1u << 16)
+#define JOYTIME_BUTTON_RSTICK (1u << 17)
+#define JOYTIME_BUTTON_HOME (1u << 18)
+#define JOYTIME_BUTTON_CAPTURE (1u << 19)
+
+/*
+ * A consistent copy of a controller's decoded state, filled in by `Joytime_Controller_snapshot`.
+ * Unlike the `Joytime_Controller_get...` pointers, it doesn't depend on the C++ layout
+ */
+typedef struct _Joytime_ControllerState {
+  /* number of reports decoded so far; changes whenever the state does */
+  uint64_t sequence;
+  uint8_t timer;
+  uint8_t battery; /* Joytime_ControllerBatteryStatus */
+  uint32_t buttons; /* JOYTIME_BUTTON_... bits */
+  Joytime_Stick leftStick;
+  Joytime_Stick rightStick;
+  Joytime_SixAxis accelerometer;
+  Joytime_SixAxis gyroscope;
+} Joytime_ControllerState;
+
+/* one IMU sample. standard input reports carry three of them, about 5ms apart */
+typedef struct _Joytime_SixAxisSample {
+  /* the report timer of the report it came in, and its position in that report (0-2) */
+  uint8_t timer;
+  uint8_t index;
+  Joytime_SixAxis accelerometer;
+  Joytime_SixAxis gyroscope;
+} Joytime_SixAxisSample;
+
+typedef struct _Joytime_ControllerStatistics {
+  uint64_t reports;
+  uint64_t truncatedReports;
+  uint64_t subcommandsSent;
+  uint64_t subcommandsFailed;
+  uint64_t rumblesSent;
+  uint64_t rumblesSkipped;
+  uint64_t sixAxisSamplesDropped;
+} Joytime_ControllerStatistics;
+
+/* called once an async operation is done; `userData` is whatever was passed with it */
+typedef void (Joytime_CompletionCallback)(Joytime_Controller* controller, bool success, void* userData);
+/* `data` is NULL if the read failed */
+typedef void (Joytime_SPIFlashCallback)(Joytime_Controller* controller, const uint8_t* data, size_t size, void* userData);
+
 JOYTIME_CORE_EXPORT Joytime_Rumble* Joytime_Rumble_newFromFreqAndAmpSame(double frequency, double amplitude);
 JOYTIME_CORE_EXPORT Joytime_Rumble* Joytime_Rumble_newFromFreqAndAmpDiff(double highFrequency, double highAmplitude, double lowFrequency, double lowAmplitude);
 JOYTIME_CORE_EXPORT Joytime_Rumble* Joytime_Rumble_newFromPreencoded(uint16_t highFrequency, uint8_t highAmplitude, uint8_t lowFrequency, uint16_t lowAmplitude);
+/* the returned pointer is owned by `rumble` and overwritten by the next call; prefer `Joytime_Rumble_encode` */
 JOYTIME_CORE_EXPORT uint8_t* Joytime_Rumble_toBuffer(Joytime_Rumble* rumble);
+/* writes the 4 encoded bytes into `buffer` */
+JOYTIME_CORE_EXPORT void Joytime_Rumble_encode(Joytime_Rumble* rumble, uint8_t* buffer);
 JOYTIME_CORE_EXPORT uint16_t* Joytime_Rumble_getHighFrequency(Joytime_Rumble* rumble);
 JOYTIME_CORE_EXPORT uint8_t* Joytime_Rumble_getHighAmplitude(Joytime_Rumble* rumble);
 JOYTIME_CORE_EXPORT uint8_t* Joytime_Rumble_getLowFrequency(Joytime_Rumble* rumble);
@@ -137,6 +232,7 @@ JOYTIME_CORE_EXPORT uint8_t Joytime_Rumble_amplitudeToHA(double amplitude);
 JOYTIME_CORE_EXPORT uint16_t Joytime_Rumble_amplitudeToLA(double amplitude);
 
 JOYTIME_CORE_EXPORT Joytime_Controller* Joytime_Controller_new(Joytime_ControllerType type, void* handle, Joytime_TransmitBufferFunction* transmitBuffer, Joytime_ReceiveBufferFunction* receiveBuffer);
+JOYTIME_CORE_EXPORT Joytime_Controller* Joytime_Controller_newWithTransport(Joytime_ControllerType type, void* handle, const Joytime_Transport* transport);
 JOYTIME_CORE_EXPORT void Joytime_Controller_free(Joytime_Controller* controller);
 JOYTIME_CORE_EXPORT void Joytime_Controller_initialize(Joytime_Controller* controller, bool calibrate);
 JOYTIME_CORE_EXPORT void Joytime_Controller_setVibrate(Joytime_Controller* controller, bool vibrate);
@@ -144,6 +240,8 @@ JOYTIME_CORE_EXPORT void Joytime_Controller_setSixAxisEnabled(Joytime_Controller
 JOYTIME_CORE_EXPORT void Joytime_Controller_setInputReportMode(Joytime_Controller* controller, Joytime_ControllerInputReportMode mode);
 JOYTIME_CORE_EXPORT void Joytime_Controller_rumbleSame(Joytime_Controller* controller, uint8_t timing, Joytime_Rumble* rumble);
 JOYTIME_CORE_EXPORT void Joytime_Controller_rumbleEach(Joytime_Controller* controller, uint8_t timing, Joytime_Rumble* rumble1, Joytime_Rumble* rumble2);
+/* sends two already-encoded 4-byte frames (e.g. from `Joytime_Rumble_encode`) */
+JOYTIME_CORE_EXPORT void Joytime_Controller_rumbleEncoded(Joytime_Controller* controller, uint8_t timing, const uint8_t* leftFrame, const uint8_t* rightFrame);
 JOYTIME_CORE_EXPORT void Joytime_Controller_setLEDs(Joytime_Controller* controller, Joytime_ControllerLEDState led1, Joytime_ControllerLEDState led2, Joytime_ControllerLEDState led3, Joytime_ControllerLEDState led4);
 JOYTIME_CORE_EXPORT void Joytime_Controller_setPowerState(Joytime_Controller* controller, Joytime_ControllerPowerState state);
 JOYTIME_CORE_EXPORT int Joytime_Controller_readSPIFlash(Joytime_Controller* controller, int32_t address, uint8_t length, uint8_t* buf);
@@ -164,6 +262,24 @@ JOYTIME_CORE_EXPORT Joytime_Stick* Joytime_Controller_getRightStick(Joytime_Cont
 JOYTIME_CORE_EXPORT Joytime_SixAxis* Joytime_Controller_getAccelerometer(Joytime_Controller* controller);
 JOYTIME_CORE_EXPORT Joytime_SixAxis* Joytime_Controller_getGyroscope(Joytime_Controller* controller);
 
+/* reads and decodes whatever reports are available, waiting at most `timeout` milliseconds for the first.
+   this is also what completes the async operations below. returns the number of reports handled */
+JOYTIME_CORE_EXPORT size_t Joytime_Controller_poll(Joytime_Controller* controller, int timeout);
+/* safe to call from any thread */
+JOYTIME_CORE_EXPORT void Joytime_Controller_snapshot(Joytime_Controller* controller, Joytime_ControllerState* state);
+/* moves up to `capacity` IMU samples into `samples`, oldest first. returns how many were moved */
+JOYTIME_CORE_EXPORT size_t Joytime_Controller_readSixAxisSamples(Joytime_Controller* controller, Joytime_SixAxisSample* samples, size_t capacity);
+JOYTIME_CORE_EXPORT void Joytime_Controller_getStatistics(Joytime_Controller* controller, Joytime_ControllerStatistics* statistics);
+
+/* these return immediately; `callback` (which may be NULL) is called from `Joytime_Controller_poll` */
+JOYTIME_CORE_EXPORT void Joytime_Controller_initializeAsync(Joytime_Controller* controller, bool calibrate, Joytime_CompletionCallback* callback, void* userData);
+JOYTIME_CORE_EXPORT void Joytime_Controller_setVibrateAsync(Joytime_Controller* controller, bool vibrate, Joytime_CompletionCallback* callback, void* userData);
+JOYTIME_CORE_EXPORT void Joytime_Controller_setSixAxisEnabledAsync(Joytime_Controller* controller, bool enabled, Joytime_CompletionCallback* callback, void* userData);
+JOYTIME_CORE_EXPORT void Joytime_Controller_setInputReportModeAsync(Joytime_Controller* controller, Joytime_ControllerInputReportMode mode, Joytime_CompletionCallback* callback, void* userData);
+JOYTIME_CORE_EXPORT void Joytime_Controller_setLEDsAsync(Joytime_Controller* controller, Joytime_ControllerLEDState led1, Joytime_ControllerLEDState led2, Joytime_ControllerLEDState led3, Joytime_ControllerLEDState led4, Joytime_CompletionCallback* callback, void* userData);
+JOYTIME_CORE_EXPORT void Joytime_Controller_setPowerStateAsync(Joytime_Controller* controller, Joytime_ControllerPowerState state, Joytime_CompletionCallback* callback, void* userData);
+JOYTIME_CORE_EXPORT void Joytime_Controller_readSPIFlashAsync(Joytime_Controller* controller, int32_t address, uint8_t length, Joytime_SPIFlashCallback* callback, void* userData);
+
 static int Joytime_Controller_defaultInterval = 60;
 
 JOYTIME_CORE_EXPORT extern Joytime_Rumble* Joytime_neutralRumble;
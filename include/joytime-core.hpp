@@ -1,7 +1,18 @@
 #ifndef JOYTIME_CORE_HPP
 #define JOYTIME_CORE_HPP
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "EventEmitter.hpp"
 #include "joytime_core_EXPORTS.h"
@@ -11,6 +22,20 @@
  * If you're using C, you'll probably want to use "joytime-core.h"
  */
 
+/*
+ * Marks a global that must be initialized at compile time. The library has no
+ * dynamic initializers, so it's safe to use from other libraries' static constructors.
+ */
+#if defined(__cpp_constinit)
+#define JOYTIME_CORE_CONSTINIT constinit
+#elif defined(__clang__)
+#define JOYTIME_CORE_CONSTINIT [[clang::require_constant_initialization]]
+#elif defined(__GNUC__) && __GNUC__ >= 10
+#define JOYTIME_CORE_CONSTINIT __constinit
+#else
+#define JOYTIME_CORE_CONSTINIT
+#endif
+
 namespace Joytime {
   enum class ControllerType: uint8_t {
     LeftJoycon = 0,
@@ -20,6 +45,7 @@ namespace Joytime {
   enum class ControllerCommand: uint8_t {
     RumbleAndSubcommand = 0x01,
     SendRumble = 0x10,
+    MCURequest = 0x11,
   };
   enum class ControllerSubcommand: uint8_t {
     GetOnlyControllerState = 0x00,
@@ -27,6 +53,8 @@ namespace Joytime {
     SetInputReportMode = 0x03,
     SetPowerState = 0x06,
     ReadSPIFlash = 0x10,
+    SetMCUConfiguration = 0x21,
+    SetMCUState = 0x22,
     SetPlayerLights = 0x30,
     SetSixAxisSensor = 0x40,
     SetVibration = 0x48,
@@ -57,6 +85,50 @@ namespace Joytime {
     NFCIR = 0x31,
     StandardOSController = 0x3f,
   };
+  // the NFC/IR MCU (Right JoyCon and Pro Controller only)
+  enum class MCUState: uint8_t {
+    Suspend = 0x00,
+    Resume = 0x01,
+    ResumeForUpdate = 0x02,
+  };
+  enum class MCUMode: uint8_t {
+    Standby = 0x01,
+    NFC = 0x04,
+    IR = 0x05,
+    FirmwareUpdate = 0x06,
+  };
+  // first argument byte of a SetMCUConfiguration subcommand
+  enum class MCUConfigurationCommand: uint8_t {
+    SetMode = 0x21,
+    // followed by an IRConfigurationCommand
+    ConfigureIR = 0x23,
+  };
+  enum class IRConfigurationCommand: uint8_t {
+    SetMode = 0x01,
+    WriteRegisters = 0x04,
+  };
+  // value of the IR sensor's resolution register (binning and skipping)
+  enum class IRResolution: uint8_t {
+    R320x240 = 0x00,
+    R160x120 = 0x50,
+    R80x60 = 0x64,
+    R40x30 = 0x69,
+  };
+  // byte 10 of an MCURequest command
+  enum class MCURequest: uint8_t {
+    Status = 0x01,
+    NFC = 0x02,
+    IR = 0x03,
+  };
+  // first byte of the MCU section of an NFC/IR report
+  enum class MCUReportCode: uint8_t {
+    Empty = 0x00,
+    State = 0x01,
+    IRData = 0x03,
+    NFCState = 0x2a,
+    NFCData = 0x3a,
+    NoRequest = 0xff,
+  };
   enum class ControllerBatteryStatus: uint8_t {
     Full = 0x08,
     Medium = 0x06,
@@ -111,6 +183,9 @@ namespace Joytime {
     bool home = false;
     bool capture = false;
   };
+  // one bit per button, in the order they're declared in `Buttons` (a = bit 0, capture = bit 19)
+  JOYTIME_CORE_EXPORT uint32_t packButtons(const Buttons& buttons);
+  JOYTIME_CORE_EXPORT Buttons unpackButtons(uint32_t mask);
   struct Stick {
     int16_t x = 0;
     int16_t y = 0;
@@ -120,11 +195,211 @@ namespace Joytime {
     double y = 0;
     double z = 0;
   };
+  // a consistent copy of everything decoded from a controller's reports
+  struct ControllerState {
+    // number of reports decoded so far; changes whenever the state does
+    uint64_t sequence = 0;
+    // the controller's own report timer (increments with every report it sends)
+    uint8_t timer = 0;
+    ControllerBatteryStatus battery = ControllerBatteryStatus::Empty;
+    Buttons buttons;
+    Stick leftStick;
+    Stick rightStick;
+    SixAxis accelerometer;
+    SixAxis gyroscope;
+  };
+  // one IMU sample. standard input reports carry three of them, about 5ms apart
+  struct SixAxisSample {
+    // the report timer of the report it came in, and its position in that report (0-2)
+    uint8_t timer = 0;
+    uint8_t index = 0;
+    SixAxis accelerometer;
+    SixAxis gyroscope;
+  };
+  // counters kept by every Controller, for instrumentation
+  struct ControllerStatistics {
+    uint64_t reports = 0;
+    // reports shorter than their report code calls for
+    uint64_t truncatedReports = 0;
+    uint64_t subcommandsSent = 0;
+    // failed to send or timed out
+    uint64_t subcommandsFailed = 0;
+    uint64_t rumblesSent = 0;
+    // repeats that weren't sent, and coalesced rumbles replaced before they were
+    uint64_t rumblesSkipped = 0;
+    // samples overwritten before `readSixAxisSamples` got to them
+    uint64_t sixAxisSamplesDropped = 0;
+  };
+  // from the GetDeviceInfo subcommand
+  struct DeviceInfo {
+    uint8_t firmwareMajor = 0;
+    uint8_t firmwareMinor = 0;
+    // 1 = left JoyCon, 2 = right JoyCon, 3 = Pro Controller
+    uint8_t type = 0;
+    // most significant byte first
+    uint8_t mac[6] = {};
+  };
   typedef void (TransmitBufferFunction)(void*, std::vector<uint8_t>);
   typedef std::vector<uint8_t> (ReceiveBufferFunction)(void*, int);
   typedef void (CTransmitBufferFunction)(void*, uint8_t*, int);
   typedef uint8_t* (CReceiveBufferFunction)(void*, int, int*);
+  // called with every report a ReportQueue receives, before it's queued
+  typedef void (ReportObserver)(void* context, const uint8_t* data, size_t size);
+  // non-owning views over a single packet, used by the Transport batch calls
+  struct PacketView {
+    uint8_t* data = nullptr;
+    size_t size = 0;
+  };
+  struct ConstPacketView {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+  };
+  /*
+   * The MCU section of an NFC/IR (0x31) report: bytes 49 through 361.
+   * It points straight into the report being decoded, so it's only valid
+   * for the duration of the listener call; copy anything you want to keep.
+   */
+  struct MCUReportView {
+    MCUReportCode code = MCUReportCode::Empty;
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+  };
+  // CRC-8 (polynomial 0x07) used by the MCU to check its configuration and request packets
+  JOYTIME_CORE_EXPORT uint8_t mcuCRC8(const uint8_t* data, size_t size);
+  /*
+   * The interface input libraries implement to move packets to and from a controller.
+   * Packets are passed as plain buffers owned by the caller, so nothing on the
+   * hot path has to allocate or copy.
+   */
+  class JOYTIME_CORE_EXPORT Transport {
+    public:
+      virtual ~Transport();
+
+      // sends one packet. returns the number of bytes sent, or -1 on error
+      virtual int send(const uint8_t* data, size_t size) = 0;
+      // receives one packet into `data`, waiting at most `timeout` milliseconds
+      // (0 = don't wait). returns the number of bytes received (0 if nothing
+      // arrived in time), or -1 on error
+      virtual int receive(uint8_t* data, size_t capacity, int timeout) = 0;
+
+      // sends several packets at once. returns how many of them were sent.
+      // the default implementation just calls `send` for each one; override
+      // it if the underlying device can do better (e.g. `sendmmsg`)
+      virtual size_t sendBatch(const ConstPacketView* packets, size_t count);
+      // receives up to `count` packets. each view's `data` must point to a
+      // buffer of `size` bytes; on return, `size` holds the number of bytes
+      // received. only the first packet waits up to `timeout` milliseconds,
+      // the rest are only read if they're already available.
+      // returns how many packets were received
+      virtual size_t receiveBatch(PacketView* packets, size_t count, int timeout);
+
+      // file descriptors that become readable/writable when the transport is
+      // ready, for use with select/poll/epoll-style event loops.
+      // -1 means the transport can't be waited on like that
+      virtual int readFD() const;
+      virtual int writeFD() const;
+
+      // the largest packet the controllers send (NFC/IR mode reports)
+      static const size_t maxPacketSize = 362;
+  };
+  /*
+   * Adapts the function-pointer style transmit/receive functions (both the C++ and
+   * C flavors) to the Transport interface. This is what Controllers use internally
+   * when they're constructed with those functions.
+   */
+  class JOYTIME_CORE_EXPORT CallbackTransport: public Transport {
+    private:
+      void* handle = nullptr;
+      TransmitBufferFunction* transmitBuffer = nullptr;
+      ReceiveBufferFunction* receiveBuffer = nullptr;
+      CTransmitBufferFunction* transmitBufferC = nullptr;
+      CReceiveBufferFunction* receiveBufferC = nullptr;
+    public:
+      CallbackTransport(void* handle, TransmitBufferFunction* transmitBuffer, ReceiveBufferFunction* receiveBuffer);
+      CallbackTransport(void* handle, CTransmitBufferFunction* transmitBufferC, CReceiveBufferFunction* receiveBufferC);
+
+      int send(const uint8_t* data, size_t size) override;
+      int receive(uint8_t* data, size_t capacity, int timeout) override;
+  };
+  enum class ReportQueueOverflowPolicy: uint8_t {
+    DropNewest = 0,
+    DropOldest = 1,
+  };
+  struct ReportQueueStatistics {
+    uint64_t pushed = 0;
+    uint64_t popped = 0;
+    uint64_t dropped = 0;
+    size_t highWatermark = 0;
+  };
+  /*
+   * A bounded, lock-free, single-producer/single-consumer queue of input reports.
+   * The producer (a thread reading from the transport) receives straight into
+   * the queue's preallocated slots; the consumer (a thread decoding reports and
+   * dispatching listeners) copies them back out. When the queue is full, the
+   * overflow policy decides whether the incoming report or the oldest queued
+   * one gets dropped, so the producer never has to wait on the consumer.
+   */
+  class JOYTIME_CORE_EXPORT ReportQueue {
+    private:
+      struct Slot {
+        // 2 * position + 1 while the slot is being written,
+        // 2 * position + 2 once the report at `position` is complete
+        std::atomic<size_t> stamp;
+        uint16_t size;
+        uint8_t data[Transport::maxPacketSize];
+      };
+
+      std::unique_ptr<Slot[]> slots;
+      size_t mask;
+      ReportQueueOverflowPolicy policy;
+
+      // written by the consumer (and by the producer when dropping the oldest report)
+      alignas(64) std::atomic<size_t> head;
+      // written only by the producer
+      alignas(64) std::atomic<size_t> tail;
+
+      std::atomic<uint64_t> pushed;
+      std::atomic<uint64_t> dropped;
+      std::atomic<uint64_t> popped;
+      std::atomic<size_t> highWatermark;
+
+      void dropOldest();
+      void publish(size_t position, size_t size);
+    public:
+      // capacity is rounded up to a power of two
+      ReportQueue(size_t capacity, ReportQueueOverflowPolicy policy = ReportQueueOverflowPolicy::DropOldest);
+
+      // producer side. copies a report into the queue. returns false if it was dropped
+      bool push(const uint8_t* data, size_t size);
+      // producer side. receives up to `maxReports` reports from the transport
+      // directly into the queue, waiting at most `timeout` milliseconds for the first.
+      // `observer`, if set, sees each report as it's received.
+      // returns the number of reports received (including any that got dropped)
+      size_t receiveFrom(Transport* transport, int timeout, size_t maxReports = maxBatchSize, ReportObserver* observer = nullptr, void* context = nullptr);
+
+      // consumer side. copies the oldest report into `data` (which must hold
+      // Transport::maxPacketSize bytes) and removes it. returns its size, or 0 if empty
+      size_t pop(uint8_t* data);
+
+      size_t size() const;
+      size_t capacity() const;
+      ReportQueueStatistics statistics() const;
+
+      // the most reports `receiveFrom` will read in a single call
+      static const size_t maxBatchSize = 16;
+  };
+  // the 4 bytes a rumble is sent as, for one side
+  typedef std::array<uint8_t, 4> EncodedRumble;
+  // one rumble, in Hz and amplitude, for `Rumble::encode`
+  struct RumbleSample {
+    double highFrequency = 320.0;
+    double highAmplitude = 0.0;
+    double lowFrequency = 160.0;
+    double lowAmplitude = 0.0;
+  };
   class JOYTIME_CORE_EXPORT Rumble {
+    private:
+      EncodedRumble buffer {};
     public:
       uint16_t highFrequency;
       uint8_t highAmplitude;
@@ -133,39 +408,300 @@ namespace Joytime {
 
       Rumble(double frequency, double amplitude);
       Rumble(double highFrequency, double highAmplitude, double lowFrequency, double lowAmplitude);
-      Rumble(uint16_t highFrequency, uint8_t highAmplitude, uint8_t lowFrequency, uint16_t lowAmplitude);
+      constexpr Rumble(uint16_t highFrequency, uint8_t highAmplitude, uint8_t lowFrequency, uint16_t lowAmplitude):
+        highFrequency(highFrequency),
+        highAmplitude(highAmplitude),
+        lowFrequency(lowFrequency),
+        lowAmplitude(lowAmplitude) {};
+      constexpr EncodedRumble encoded() const {
+        return {
+          (uint8_t)(highFrequency & 0xff), // high frequency upper byte
+          (uint8_t)(highAmplitude + ((highFrequency >> 8) & 0xff)), // high frequency amplitude + high frequency lower byte
+          (uint8_t)(lowFrequency + ((lowAmplitude >> 8) & 0xff)), // low frequency + low frequency amplitude lower byte
+          (uint8_t)(lowAmplitude & 0xff), // low frequency upper byte
+        };
+      };
+      // encodes into a buffer owned by this Rumble, so the pointer is valid for as
+      // long as the Rumble is (and is overwritten by the next call). prefer `encoded`
       uint8_t* toBuffer();
       std::vector<uint8_t> toVector();
 
+      // encodes `count` samples into `count` contiguous 4-byte frames, without allocating
+      static void encode(const RumbleSample* samples, size_t count, uint8_t* frames);
+
       static uint16_t frequencyToHF(double frequency);
       static uint8_t frequencyToLF(double frequency);
       static uint8_t amplitudeToHA(double amplitude);
       static uint16_t amplitudeToLA(double amplitude);
   };
+  /*
+   * Precomputed rumble frames, ready to be sent as-is. The file format (all little endian):
+   *
+   *   0   "JTRA"
+   *   4   uint16_t version (1)
+   *   6   uint16_t channels: 1 (both sides get the same frame) or 2 (left/right frame pairs)
+   *   8   uint32_t frame count
+   *   12  uint32_t time between frames, in microseconds
+   *   16  the encoded 4-byte frames
+   *
+   * `open` maps the file into memory instead of reading it, and frames are
+   * used straight from the mapping.
+   */
+  class JOYTIME_CORE_EXPORT RumbleAsset {
+    private:
+      const uint8_t* data = nullptr;
+      size_t size = 0;
+      void* mapping = nullptr;
+      size_t mappingSize = 0;
+      std::vector<uint8_t> owned;
+
+      uint16_t channelCount = 1;
+      uint32_t count = 0;
+      uint32_t interval = 0;
+
+      void parse();
+      void unmap();
+    public:
+      RumbleAsset() = default;
+      // a view over an asset already in memory; `data` must outlive the asset
+      RumbleAsset(const uint8_t* data, size_t size);
+      RumbleAsset(RumbleAsset&& other) noexcept;
+      RumbleAsset& operator=(RumbleAsset&& other) noexcept;
+      RumbleAsset(const RumbleAsset&) = delete;
+      RumbleAsset& operator=(const RumbleAsset&) = delete;
+      ~RumbleAsset();
+
+      // maps an asset file into memory. throws if it can't be opened or isn't an asset
+      static RumbleAsset open(const char* path);
+      // encodes samples into an asset. with 2 channels, samples are left/right pairs
+      static RumbleAsset bake(const RumbleSample* samples, size_t count, uint16_t channels, uint32_t frameInterval);
+      // writes the asset to a file. throws on failure
+      void save(const char* path) const;
+
+      uint16_t channels() const;
+      uint32_t frameCount() const;
+      // microseconds between frames
+      uint32_t frameInterval() const;
+      // the encoded 4-byte frame for a side (0 = left, 1 = right) of frame `index`, or
+      // nullptr if there's no such frame or side. one-channel assets have the same frame for both
+      const uint8_t* frame(uint32_t index, int side = 0) const;
+      // the whole file, e.g. to send it somewhere else
+      const uint8_t* bytes() const;
+      size_t byteSize() const;
+
+      static const size_t headerSize = 16;
+      static const uint16_t version = 1;
+  };
+  class Controller;
+  /*
+   * Plays a RumbleAsset back on a controller, straight from its encoded frames. Call
+   * `update` regularly (e.g. from the loop calling `Controller::poll`); it sends
+   * whichever frame is due by then, if it hasn't been sent yet. Frames closer together
+   * than `Controller::rumbleInterval` are coalesced like any other rumble.
+   */
+  class JOYTIME_CORE_EXPORT RumblePlayer {
+    private:
+      const RumbleAsset* asset = nullptr;
+      bool loop = false;
+      std::chrono::steady_clock::time_point startedAt;
+      uint32_t sentFrame = 0;
+      bool frameSent = false;
+      bool stopPending = false;
+    public:
+      // `asset` must outlive the playback
+      void play(const RumbleAsset& asset, bool loop = false);
+      // the next `update` stops the motors
+      void stop();
+      bool playing() const;
+      // sends the frame that's due, or stops the motors once the asset is over.
+      // returns whether it's still playing
+      bool update(Controller* controller, uint8_t timing = 0);
+  };
+  /*
+   * Puts IR camera frames back together from the fragments the MCU sends them in,
+   * one per NFC/IR report. The frame buffer is allocated once, up front, and reused
+   * for every frame; a frame is only reported complete once every one of its
+   * fragments has arrived.
+   */
+  class JOYTIME_CORE_EXPORT IRFrameAssembler {
+    private:
+      std::vector<uint8_t> frame;
+      uint8_t* target;
+      std::vector<bool> received;
+      size_t receivedCount = 0;
+      uint8_t lastFragment;
+      int previousFragment = -1;
+      bool complete = false;
+
+      void reset();
+    public:
+      // `lastFragment` is the number of the last fragment in a frame, which depends
+      // on the camera resolution: 0xff for 320x240, 0x3f for 160x120, 0x0f for 80x60
+      // and 0x03 for 40x30
+      IRFrameAssembler(uint8_t lastFragment = 0xff);
+      // assembles into `buffer` (of `(lastFragment + 1) * fragmentSize` bytes) instead
+      // of a buffer of its own
+      IRFrameAssembler(uint8_t lastFragment, uint8_t* buffer);
+      IRFrameAssembler(const IRFrameAssembler&) = delete;
+      IRFrameAssembler& operator=(const IRFrameAssembler&) = delete;
+
+      // starts over, assembling the next frame into `buffer` (see above)
+      void setBuffer(uint8_t* buffer);
+
+      // feeds in the MCU section of a report. returns the fragment number if it was
+      // an IR fragment, or -1 if it wasn't
+      int feed(const MCUReportView& report);
+      // whether `data` currently holds a complete frame. stays true until
+      // the first fragment of the next frame arrives
+      bool frameComplete() const;
+      const uint8_t* data() const;
+      size_t size() const;
+      size_t fragmentCount() const;
+
+      // image bytes carried by each fragment
+      static const size_t fragmentSize = 300;
+      // offset of the fragment number and image data within the MCU section
+      static const size_t fragmentNumberOffset = 3;
+      static const size_t fragmentDataOffset = 10;
+  };
+  class Controller;
+  // `report` is only valid during the call (see MCUReportView)
+  typedef std::function<void(Controller* controller, const MCUReportView& report)> MCUListener;
+  // `reply` is the full subcommand reply report, or nullptr if the subcommand failed or timed out
+  typedef std::function<void(Controller* controller, const uint8_t* reply, size_t size)> SubcommandCallback;
+  typedef std::function<void(Controller* controller, bool success)> CompletionCallback;
+  // `data` is the data read, or nullptr if the read failed or timed out
+  typedef std::function<void(Controller* controller, const uint8_t* data, size_t size)> SPIFlashCallback;
+  // `info` is nullptr if the subcommand failed or timed out
+  typedef std::function<void(Controller* controller, const DeviceInfo* info)> DeviceInfoCallback;
+  /*
+   * Thread safety:
+   *   - commands (`rumble`, `setLEDs`, `readSPIFlash`, etc.) can be sent from any
+   *     number of threads at once, including while another thread runs `update`
+   *     or `receiveReports`/`processReports`. Sends are serialized, and subcommand
+   *     replies are handed to whichever thread is waiting for them, no matter which
+   *     thread actually read them off the transport.
+   *   - `snapshot()` can be called from any thread and never returns a torn state.
+   *   - the public state fields (`buttons`, `leftStick`, etc.) are only safe to read
+   *     from `updated` listeners or from the thread that decodes reports.
+   *   - `initialize` writes the calibration data, so call it before sharing the
+   *     controller with other threads.
+   */
   class JOYTIME_CORE_EXPORT Controller {
     private:
-      TransmitBufferFunction* transmitBuffer = nullptr;
-      ReceiveBufferFunction* receiveBuffer = nullptr;
-      CTransmitBufferFunction* transmitBufferC = nullptr;
-      CReceiveBufferFunction* receiveBufferC = nullptr;
-      bool usable = false;
+      struct QueuedSubcommand {
+        ControllerCommand command;
+        uint8_t subcommand;
+        std::vector<uint8_t> data;
+        SubcommandCallback callback;
+        // in milliseconds. 0 uses `subcommandTimeout`
+        int timeout = 0;
+      };
+
+      std::shared_ptr<Transport> transport;
+      std::unique_ptr<ReportQueue> reportQueue;
+      std::atomic<bool> usable { false };
       bool initializable = true;
 
       // global packet counter for subcommands,
       // loops in 0x0 through 0xf
-      uint8_t counter = 0;
+      std::atomic<uint8_t> counter { 0 };
 
+      // serializes writes to the transport
+      std::mutex transmitMutex;
+      // held by whichever thread is reading from the transport
+      std::mutex receiveMutex;
+      // subcommands are sent one at a time, in order: replies only echo
+      // the subcommand ID, not the packet counter. the front of the queue
+      // is the one in flight
+      std::mutex subcommandMutex;
+      std::deque<QueuedSubcommand> subcommandQueue;
+      bool subcommandInFlight = false;
+      std::chrono::steady_clock::time_point subcommandSentAt;
+
+      // seqlock around `publishedState`: odd while it's being written
+      std::atomic<uint32_t> stateVersion { 0 };
+      ControllerState publishedState;
+      std::mutex decodeMutex;
+
+      // copied on write, so dispatching a report doesn't copy any listeners
+      typedef std::vector<std::pair<unsigned int, MCUListener>> MCUListenerList;
+      std::shared_ptr<const MCUListenerList> mcuListeners;
+      std::mutex mcuListenerMutex;
+      unsigned int mcuListenerCounter = 0;
+
+      // rumble frames (left and right halves) waiting for or last sent over the link
+      std::mutex rumbleMutex;
+      uint8_t sentRumble[8];
+      uint8_t pendingRumble[8];
+      uint8_t pendingRumbleTiming = 0;
+      bool rumbleSent = false;
+      bool rumblePending = false;
+      std::chrono::steady_clock::time_point rumbleSentAt;
+
+      // low-power mode. only touched while holding `decodeMutex`
+      int lowPowerIdleTimeout = 0;
+      uint8_t lastReportCode = 0;
+      std::chrono::steady_clock::time_point lastActivity;
+      std::atomic<bool> reportModeSwitchPending { false };
+
+      // IMU samples from the latest reports, oldest first, until `readSixAxisSamples` takes them
+      static const size_t sixAxisBufferSize = 48;
+      std::mutex sixAxisMutex;
+      SixAxisSample sixAxisSamples[sixAxisBufferSize];
+      size_t sixAxisStart = 0;
+      size_t sixAxisCount = 0;
+
+      // see `statistics`. relaxed; they're only ever read as a rough picture
+      struct Counters {
+        std::atomic<uint64_t> reports { 0 };
+        std::atomic<uint64_t> truncatedReports { 0 };
+        std::atomic<uint64_t> subcommandsSent { 0 };
+        std::atomic<uint64_t> subcommandsFailed { 0 };
+        std::atomic<uint64_t> rumblesSent { 0 };
+        std::atomic<uint64_t> rumblesSkipped { 0 };
+        std::atomic<uint64_t> sixAxisSamplesDropped { 0 };
+      };
+      Counters counters;
+
+      uint8_t nextPacketCounter();
       void performUsabilityCheck();
-      void update(std::vector<uint8_t> buf);
-      void transmitBuffer_(std::vector<uint8_t> buffer);
-      std::vector<uint8_t> receiveResponse_();
-      std::vector<uint8_t> sendCommand(Joytime::ControllerCommand command, std::vector<uint8_t> buf);
-      std::vector<uint8_t> sendSubcommand(Joytime::ControllerCommand command, Joytime::ControllerSubcommand subcommand, std::vector<uint8_t> buf);
+      void update(const uint8_t* buf, size_t size);
+      void decodeReport(const uint8_t* buf, size_t size, ControllerState& state);
+      void decodeSimpleHIDReport(const uint8_t* buf, size_t size, ControllerState& state);
+      bool checkLowPower(const uint8_t* buf, const ControllerState& previous, const ControllerState& state, ControllerInputReportMode& mode);
+      void storeSixAxisSamples(const uint8_t* buf, size_t size);
+      void applyCalibration(const std::vector<uint8_t>* buffers);
+      void transmitNextSubcommand(std::unique_lock<std::mutex>& lock);
+      void failInFlightSubcommand(std::unique_lock<std::mutex>& lock);
+      void checkSubcommandTimeout();
+      void sendSubcommandAsync(Joytime::ControllerCommand command, Joytime::ControllerSubcommand subcommand, const uint8_t* data, size_t size, SubcommandCallback callback, int timeout = 0);
+      void routeReport(const uint8_t* buf, size_t size);
+      void dispatchMCUReport(const uint8_t* buf, size_t size);
+      void queueRumble(uint8_t timing, const uint8_t* left, const uint8_t* right);
+      void transmitRumble(uint8_t timing, const uint8_t* frame);
+      static void routeReport(void* controller, const uint8_t* buf, size_t size);
+      void transmitBuffer_(const uint8_t* buffer, size_t size);
+      size_t receiveResponse_(uint8_t* buffer, size_t capacity);
+      size_t sendCommand(Joytime::ControllerCommand command, const uint8_t* data, size_t size, uint8_t* reply);
+      size_t sendSubcommand(Joytime::ControllerCommand command, Joytime::ControllerSubcommand subcommand, const uint8_t* data, size_t size, uint8_t* reply, int timeout = 0);
     public:
       // suggested update interval, in milliseconds
       int interval = 60;
+      // how long to wait for a subcommand reply before giving up, in milliseconds.
+      // 0 waits forever. methods with a `timeout` argument override it for their own
+      // subcommands (unless they're passed 0)
+      int subcommandTimeout = 0;
+      // minimum time between two rumble packets, in milliseconds. rumbles requested
+      // in between are coalesced: only the latest one is sent, once the interval is up
+      int rumbleInterval = defaultRumbleInterval;
+      // how often a rumble that's still going is sent again so the motors don't
+      // stop, in milliseconds. 0 disables it
+      int rumbleKeepAlive = defaultRumbleKeepAlive;
       void* handle;
       ControllerType type;
+      // the controller's report timer, as of the last report
+      uint8_t timer = 0;
       ControllerBatteryStatus battery;
       StickCalibrationData leftStickCalibration;
       StickCalibrationData rightStickCalibration;
@@ -182,25 +718,759 @@ namespace Joytime {
       Controller(const Controller&);
       Controller(ControllerType type, void* handle, TransmitBufferFunction* sendBuffer, ReceiveBufferFunction* receiveBuffer);
       Controller(ControllerType type, void* handle, CTransmitBufferFunction* sendBufferC, CReceiveBufferFunction* receiveBufferC);
-      void initialize(bool calibrate = false);
+      // the transport is not owned by the controller; it must outlive it
+      Controller(ControllerType type, void* handle, Transport* transport);
+      Controller(ControllerType type, void* handle, std::shared_ptr<Transport> transport);
+      void initialize(bool calibrate = false, int timeout = 0);
+      bool isUsable() const;
 
       void setVibration(bool vibrate);
       void setSixAxisEnabled(bool enabled);
       void setInputReportMode(ControllerInputReportMode mode);
+      /*
+       * Rumble doesn't wait for a reply. A rumble identical to the one last sent is
+       * skipped, and rumbles are sent at most once every `rumbleInterval` milliseconds.
+       * Coalesced rumbles and keep-alives go out from `poll`/`update`/`processReports`
+       * (or `flushRumble`), so keep calling one of those while rumbling.
+       */
       void rumble(uint8_t timing, Rumble* rumble);
       void rumble(uint8_t timing, Rumble* leftRumble, Rumble* rightRumble);
+      // sends already-encoded 4-byte frames (e.g. from a RumbleAsset), paced like `rumble`
+      void rumbleEncoded(uint8_t timing, const uint8_t* leftFrame, const uint8_t* rightFrame);
+      void rumbleEncoded(uint8_t timing, const EncodedRumble& leftFrame, const EncodedRumble& rightFrame);
+      // sends a coalesced rumble or a keep-alive, if one is due
+      void flushRumble();
       void setLEDs(ControllerLEDState led1, ControllerLEDState led2, ControllerLEDState led3, ControllerLEDState led4);
       void setPowerState(ControllerPowerState powerState);
-      std::vector<uint8_t> readSPIFlash(int32_t address, uint8_t size);
+      std::vector<uint8_t> readSPIFlash(int32_t address, uint8_t size, int timeout = 0);
+      DeviceInfo getDeviceInfo(int timeout = 0);
+
+      /*
+       * Non-blocking versions of the above. They queue the subcommand and return right
+       * away; the callback runs on whichever thread reads the reply (usually the one
+       * calling `poll`, `update` or `receiveReports`), so it shouldn't block. Subcommands
+       * are sent one at a time, in the order they were queued.
+       */
+      void initializeAsync(bool calibrate, CompletionCallback callback);
+      void setVibrationAsync(bool vibrate, CompletionCallback callback);
+      void setSixAxisEnabledAsync(bool enabled, CompletionCallback callback);
+      void setInputReportModeAsync(ControllerInputReportMode mode, CompletionCallback callback);
+      void setLEDsAsync(ControllerLEDState led1, ControllerLEDState led2, ControllerLEDState led3, ControllerLEDState led4, CompletionCallback callback);
+      void setPowerStateAsync(ControllerPowerState powerState, CompletionCallback callback);
+      void readSPIFlashAsync(int32_t address, uint8_t size, SPIFlashCallback callback);
+      void getDeviceInfoAsync(DeviceInfoCallback callback, int timeout = 0);
+
+      /*
+       * NFC/IR MCU control. Switch the input report mode to `NFCAndIR` to start
+       * receiving the MCU section of each report, then resume the MCU and pick its mode.
+       * `setMCUConfiguration` sends up to 36 bytes of arguments after the command
+       * byte and appends the checksum.
+       */
+      void setMCUState(MCUState state);
+      void setMCUMode(MCUMode mode);
+      void setMCUConfiguration(MCUConfigurationCommand command, const uint8_t* arguments, size_t size);
+      void setMCUStateAsync(MCUState state, CompletionCallback callback);
+      void setMCUModeAsync(MCUMode mode, CompletionCallback callback);
+      void setMCUConfigurationAsync(MCUConfigurationCommand command, const uint8_t* arguments, size_t size, CompletionCallback callback);
+      // sends an MCU request with up to 36 bytes of arguments. the MCU answers in the
+      // MCU section of the following reports, so this doesn't wait for a reply
+      void sendMCURequest(MCURequest request, const uint8_t* arguments = nullptr, size_t size = 0);
+
+      // listeners receive the MCU section of every NFC/IR report, on the decoding thread
+      unsigned int addMCUListener(MCUListener listener);
+      void removeMCUListener(unsigned int id);
+      void sendSubcommandAsync(ControllerSubcommand subcommand, const uint8_t* data, size_t size, SubcommandCallback callback, int timeout = 0);
 
       void update();
+      // reads whatever reports are available (waiting at most `timeout` milliseconds
+      // for the first), decodes them and completes any async subcommands they reply to.
+      // with the report queue enabled, this just decodes what's been queued.
+      // returns the number of reports handled
+      size_t poll(int timeout = 0);
+
+      /*
+       * Optional split between reading and decoding: one thread calls `receiveReports`
+       * to move reports from the transport into a queue, another calls `processReports`
+       * to decode them and notify `updated` listeners. A slow listener then can't delay
+       * the next read. Subcommand replies read by `receiveReports` are routed to the
+       * thread waiting for them.
+       */
+      void enableReportQueue(size_t capacity = 64, ReportQueueOverflowPolicy policy = ReportQueueOverflowPolicy::DropOldest);
+      // transport thread. returns the number of reports received
+      size_t receiveReports(int timeout);
+      // decode thread. returns the number of reports decoded
+      size_t processReports(size_t maxReports = SIZE_MAX);
+      ReportQueueStatistics reportQueueStatistics() const;
+
+      // a tear-free copy of the latest decoded state. safe to call from any thread
+      ControllerState snapshot() const;
+      // moves up to `capacity` IMU samples (all three from every standard report, not just
+      // the one in the state) into `samples`, oldest first. returns how many were moved.
+      // the last 48 are kept; older ones are dropped
+      size_t readSixAxisSamples(SixAxisSample* samples, size_t capacity);
+      ControllerStatistics statistics() const;
+
+      /*
+       * Low-power mode: after `idleTimeout` milliseconds without input, the controller is
+       * switched to SimpleHID (0x3F) reports, which it only sends when something changes,
+       * and switched back to standard (0x30) reports as soon as it's used again.
+       * SimpleHID reports carry no IMU data and only 8-bit (Pro Controller) or
+       * 8-direction (JoyCon) stick data. Controllers in any other report mode are left alone.
+       * Once the sticks are calibrated (see `initialize`), a stick counts as input when
+       * it's pushed away from the center; before that, only when it moves.
+       */
+      void enableLowPowerMode(int idleTimeout = defaultLowPowerIdleTimeout);
+      // also switches the controller back to standard reports, if needed
+      void disableLowPowerMode();
 
       // default suggested update interval, in milliseconds
       static const int defaultInterval = 60;
+      static const int defaultLowPowerIdleTimeout = 5000;
+      // about one report period over Bluetooth
+      static const int defaultRumbleInterval = 15;
+      static const int defaultRumbleKeepAlive = 500;
+      // how far a stick has to move from the center to count as input
+      static const int lowPowerStickThreshold = 256;
+      // number of SPI flash reads `initialize` does when calibrating
+      static const size_t calibrationReadCount = 6;
+  };
+
+  // the state of a left/right JoyCon pair, as one controller
+  struct CombinedControllerState {
+    // number of merged states produced so far
+    uint64_t sequence = 0;
+    // each side's report timer, as of the reports merged into this state
+    uint8_t leftTimer = 0;
+    uint8_t rightTimer = 0;
+    ControllerBatteryStatus leftBattery = ControllerBatteryStatus::Empty;
+    ControllerBatteryStatus rightBattery = ControllerBatteryStatus::Empty;
+    Buttons buttons;
+    Stick leftStick;
+    Stick rightStick;
+    SixAxis leftAccelerometer;
+    SixAxis leftGyroscope;
+    SixAxis rightAccelerometer;
+    SixAxis rightGyroscope;
   };
+  /*
+   * Merges a left and a right JoyCon into a single controller. Each side's report
+   * timer is unwrapped into a running tick count, and a merged state is only
+   * published once both sides have reported past the last merged point, so the
+   * two halves of a state always come from the same stretch of time. If one side
+   * falls more than `maxTimerSkew` ticks behind (e.g. it dropped out), the other
+   * side's reports are published on their own until it catches up.
+   *
+   * Each side's fields are written straight from that controller into the merged
+   * state as its report is decoded; nothing else is copied.
+   */
+  class JOYTIME_CORE_EXPORT CombinedController {
+    private:
+      Controller* left;
+      Controller* right;
+      unsigned int leftHandler = 0;
+      unsigned int rightHandler = 0;
+
+      mutable std::mutex mutex;
+      CombinedControllerState merging;
+      CombinedControllerState published;
+      bool leftStarted = false;
+      bool rightStarted = false;
+      uint64_t leftTicks = 0;
+      uint64_t rightTicks = 0;
+      uint64_t mergedTicks = 0;
+      // left SL, left SR, right SL, right SR
+      bool sideRails[4] = { false, false, false, false };
+
+      void merge(Controller* controller);
+      static uint64_t advance(uint64_t ticks, uint8_t previousTimer, uint8_t timer, bool& started);
+    public:
+      // how far (in timer ticks) one side may run ahead before it's published alone
+      uint64_t maxTimerSkew = 16;
+
+      EventEmitter<CombinedController*> updated;
+
+      CombinedController(Controller* left, Controller* right);
+      CombinedController(const CombinedController&) = delete;
+      CombinedController& operator=(const CombinedController&) = delete;
+      ~CombinedController();
+
+      Controller* leftController() const;
+      Controller* rightController() const;
+
+      // the latest merged state. safe to call from any thread
+      CombinedControllerState snapshot() const;
+
+      // sends each rumble to its own side
+      void rumble(uint8_t timing, Rumble* leftRumble, Rumble* rightRumble);
+      // sends the same rumble to both sides
+      void rumble(uint8_t timing, Rumble* rumble);
+  };
+  /*
+   * The One-Euro filter (Casiez et al.): a low-pass filter whose cutoff rises with
+   * the speed of the signal, so slow movements are smoothed and fast ones aren't
+   * delayed. `minCutoff` (Hz) sets the smoothing at rest and `beta` how quickly the
+   * cutoff rises with speed.
+   */
+  class JOYTIME_CORE_EXPORT OneEuroFilter {
+    private:
+      bool started = false;
+      double value_ = 0;
+      double rawValue = 0;
+      double derivative_ = 0;
+    public:
+      double minCutoff;
+      double beta;
+      double derivativeCutoff;
+
+      OneEuroFilter(double minCutoff = 1.0, double beta = 0.0, double derivativeCutoff = 1.0);
+
+      // filters `value`, `interval` seconds after the last one
+      double filter(double value, double interval);
+      // the last filtered value, and its filtered rate of change (per second)
+      double value() const;
+      double derivative() const;
+      void reset();
+  };
+  struct Quaternion {
+    double w = 1;
+    double x = 0;
+    double y = 0;
+    double z = 0;
+  };
+  struct FilteredStick {
+    double x = 0;
+    double y = 0;
+  };
+  // filtered (and possibly predicted) motion input, as of `time`
+  struct MotionState {
+    std::chrono::steady_clock::time_point time;
+    // in the same units as `Stick`
+    FilteredStick leftStick;
+    FilteredStick rightStick;
+    // in degrees per second, like `ControllerState::gyroscope`
+    SixAxis gyroscope;
+    // integrated from the gyroscope since the first report (or `resetOrientation`)
+    Quaternion orientation;
+  };
+  /*
+   * Smooths stick and gyroscope input and predicts it a little into the future, to
+   * hide jitter and transport latency.
+   *
+   * Each report is timestamped from the controller's report timer (unwrapped like
+   * CombinedController's, about 5ms a tick), anchored to the earliest arrival seen so
+   * far, so bursts of reports delivered together are spread back out over the time they
+   * were sent in. Sticks and gyroscope then go through One-Euro filters, and the
+   * orientation is integrated from the gyroscope.
+   *
+   * `stateAt(time)` interpolates between the last `historySize` states for times in the
+   * past, and extrapolates from the last one (the sticks along their filtered velocity,
+   * the orientation along the filtered gyroscope) for times after it, at most
+   * `maxPrediction` milliseconds ahead.
+   *
+   * The orientation has no accelerometer correction, so it drifts; reset it as needed.
+   */
+  class JOYTIME_CORE_EXPORT MotionPredictor {
+    private:
+      Controller* controller = nullptr;
+      unsigned int updatedHandler = 0;
+
+      mutable std::mutex mutex;
+      OneEuroFilter leftStickX;
+      OneEuroFilter leftStickY;
+      OneEuroFilter rightStickX;
+      OneEuroFilter rightStickY;
+      OneEuroFilter gyroscopeX;
+      OneEuroFilter gyroscopeY;
+      OneEuroFilter gyroscopeZ;
+      Quaternion orientation;
+
+      bool started = false;
+      uint8_t lastTimer = 0;
+      uint64_t ticks = 0;
+      std::chrono::steady_clock::time_point lastReceivedAt;
+      // report time = `ticks` timer periods after `origin`
+      std::chrono::steady_clock::time_point origin;
+
+      // recent states, for `stateAt` times in the past
+      static const size_t historySize = 16;
+      MotionState history[historySize];
+      size_t historyStart = 0;
+      size_t historyCount = 0;
+
+      std::chrono::steady_clock::time_point reportTime(uint8_t timer, std::chrono::steady_clock::time_point receivedAt, bool& timed);
+      MotionState predict(const MotionState& state, std::chrono::steady_clock::time_point time) const;
+    public:
+      // in milliseconds
+      int maxPrediction = defaultMaxPrediction;
+
+      // feed it with `update`
+      MotionPredictor();
+      // follows `controller`, which must outlive it
+      explicit MotionPredictor(Controller* controller);
+      MotionPredictor(const MotionPredictor&) = delete;
+      MotionPredictor& operator=(const MotionPredictor&) = delete;
+      ~MotionPredictor();
+
+      // sets the filter parameters for the sticks and the gyroscope (see OneEuroFilter)
+      void setStickFilter(double minCutoff, double beta);
+      void setGyroscopeFilter(double minCutoff, double beta);
+
+      // adds a decoded state, received at `receivedAt`
+      void update(const ControllerState& state, std::chrono::steady_clock::time_point receivedAt = std::chrono::steady_clock::now());
+      // the state at `time`. safe to call from any thread
+      MotionState stateAt(std::chrono::steady_clock::time_point time) const;
+      // the latest filtered state, without prediction
+      MotionState latest() const;
+      void resetOrientation(const Quaternion& orientation = Quaternion());
+      // forgets everything, e.g. after the controller reconnects
+      void reset();
+
+      static const int defaultMaxPrediction = 50;
+      // the report timer's period
+      static const int timerTickMicroseconds = 5000;
+      static constexpr double defaultStickMinCutoff = 1.0;
+      static constexpr double defaultStickBeta = 0.005;
+      static constexpr double defaultGyroscopeMinCutoff = 5.0;
+      static constexpr double defaultGyroscopeBeta = 0.01;
+  };
+  struct IRFrame {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    uint16_t width = 0;
+    uint16_t height = 0;
+    // counts every frame completed by the camera, delivered or not
+    uint64_t sequence = 0;
+    std::chrono::steady_clock::time_point completedAt;
+  };
+  class IRFramePool;
+  /*
+   * Exclusive access to one frame of an IRFramePool. The frame goes back to the
+   * pool when the handle is released or destroyed, so keep it only as long as you
+   * need the image. Handles can be moved (e.g. to another thread), but not copied.
+   */
+  class JOYTIME_CORE_EXPORT IRFrameHandle {
+    private:
+      std::shared_ptr<IRFramePool> pool;
+      size_t index = 0;
+    public:
+      IRFrameHandle() = default;
+      IRFrameHandle(std::shared_ptr<IRFramePool> pool, size_t index);
+      IRFrameHandle(IRFrameHandle&& other) noexcept;
+      IRFrameHandle& operator=(IRFrameHandle&& other) noexcept;
+      IRFrameHandle(const IRFrameHandle&) = delete;
+      IRFrameHandle& operator=(const IRFrameHandle&) = delete;
+      ~IRFrameHandle();
+
+      void release();
+      explicit operator bool() const;
+      const IRFrame& operator*() const;
+      const IRFrame* operator->() const;
+  };
+  /*
+   * A fixed number of frame buffers, allocated once. Acquiring and releasing
+   * frames never allocates.
+   */
+  class JOYTIME_CORE_EXPORT IRFramePool {
+    private:
+      std::vector<uint8_t> storage;
+      std::vector<IRFrame> frames;
+      std::vector<size_t> available;
+      mutable std::mutex mutex;
+    public:
+      IRFramePool(size_t frameCount, size_t frameSize);
+
+      // returns the index of a free frame, or -1 if they're all in use
+      long acquire();
+      void release(size_t index);
+      uint8_t* buffer(size_t index);
+      IRFrame& frame(size_t index);
+      size_t frameCount() const;
+      size_t availableCount() const;
+  };
+  struct IRCameraConfiguration {
+    IRResolution resolution = IRResolution::R320x240;
+    uint16_t exposureMicroseconds = 300;
+    uint8_t digitalGain = 1;
+    // register 0x0010: bitfield that turns off the IR LEDs (0 = all on)
+    uint8_t leds = 0x00;
+  };
+  struct IRCameraStatistics {
+    uint64_t framesDelivered = 0;
+    // completed while every pool frame was still held by a consumer
+    uint64_t framesDropped = 0;
+    // missing fragments the camera was asked to send again
+    uint64_t fragmentsRequested = 0;
+  };
+  typedef std::function<void(Controller* controller, IRFrameHandle& frame)> IRFrameCallback;
+  /*
+   * Streams images from a Right JoyCon's IR camera. `start` sets the MCU up for
+   * image transfer and configures the sensor; fragments are then acknowledged
+   * as they come in (on the thread decoding reports, without waiting for anything)
+   * and reassembled straight into a pool of preallocated frames.
+   *
+   * Completed frames are handed to `onFrame` by handle. Move the handle out of the
+   * callback to keep the frame; otherwise it goes back to the pool when the callback
+   * returns. If every frame is in use when another one completes, that frame is dropped.
+   */
+  class JOYTIME_CORE_EXPORT IRCamera {
+    private:
+      Controller* controller;
+      IRCameraConfiguration configuration;
+      std::shared_ptr<IRFramePool> pool;
+      IRFrameAssembler assembler;
+      long assembling = -1;
+      unsigned int listener = 0;
+      std::atomic<bool> streaming { false };
+      std::atomic<bool> mcuReady { false };
+      int previousFragment = -1;
+      uint64_t sequence = 0;
+      IRCameraStatistics stats;
+      mutable std::mutex mutex;
+
+      void handleReport(const MCUReportView& report);
+      void acknowledge(uint8_t fragment, int missing = -1);
+    public:
+      IRFrameCallback onFrame;
+
+      IRCamera(Controller* controller, IRCameraConfiguration configuration = IRCameraConfiguration(), size_t poolSize = defaultPoolSize);
+      IRCamera(const IRCamera&) = delete;
+      IRCamera& operator=(const IRCamera&) = delete;
+      ~IRCamera();
+
+      // the controller must already be initialized, and something has to keep
+      // reading its reports (`poll`, `update`, etc.) for frames to arrive
+      void start();
+      void stop();
+      IRCameraStatistics statistics() const;
+
+      static uint16_t width(IRResolution resolution);
+      static uint16_t height(IRResolution resolution);
+      static uint8_t lastFragment(IRResolution resolution);
+
+      static const size_t defaultPoolSize = 4;
+      // how long `start` waits for the MCU to switch to IR mode, in milliseconds
+      static const int setupTimeout = 2000;
+  };
+
+  /*
+   * Caller-provided structure-of-arrays buffer for FleetSnapshot. Every column that's
+   * set must have room for `capacity` elements; columns left as nullptr are skipped.
+   * Row i of every column describes the same controller.
+   */
+  struct FleetSnapshotColumns {
+    size_t capacity = 0;
+    // position of the row's controller in the list passed to `capture`
+    uint32_t* index = nullptr;
+    uint64_t* sequence = nullptr;
+    uint8_t* timer = nullptr;
+    ControllerBatteryStatus* battery = nullptr;
+    // see `packButtons`
+    uint32_t* buttons = nullptr;
+    int16_t* leftStickX = nullptr;
+    int16_t* leftStickY = nullptr;
+    int16_t* rightStickX = nullptr;
+    int16_t* rightStickY = nullptr;
+    double* accelerometerX = nullptr;
+    double* accelerometerY = nullptr;
+    double* accelerometerZ = nullptr;
+    double* gyroscopeX = nullptr;
+    double* gyroscopeY = nullptr;
+    double* gyroscopeZ = nullptr;
+  };
+  /*
+   * Writes the state of a whole fleet of controllers into a FleetSnapshotColumns
+   * buffer in one call, one row per controller. Each row is a tear-free
+   * `Controller::snapshot()`, so this can run on any thread.
+   *
+   * `captureChanges` only writes the controllers that decoded a report since they were
+   * last captured. Controllers that didn't fit in the buffer are kept for the next call,
+   * which starts with them (wrapping around the list), so rows aren't necessarily in list order.
+   */
+  class JOYTIME_CORE_EXPORT FleetSnapshot {
+    private:
+      // last captured `ControllerState::sequence` for each position in the list
+      std::vector<uint64_t> capturedSequences;
+      // where the next `captureChanges` starts looking
+      size_t nextIndex = 0;
+
+      size_t write(Controller* const* controllers, size_t count, FleetSnapshotColumns& columns, bool changesOnly);
+    public:
+      // returns the number of rows written
+      size_t capture(Controller* const* controllers, size_t count, FleetSnapshotColumns& columns);
+      size_t captureChanges(Controller* const* controllers, size_t count, FleetSnapshotColumns& columns);
+      // forgets what was captured, so the next `captureChanges` writes every controller
+      void reset();
+  };
+
+  /*
+   * A ControllerState reduced to what's sent over the wire by the state delta codec:
+   * sticks keep 10 of their 12 bits, the accelerometer is in 1/4096 G and the gyroscope
+   * in 1/16 degrees per second (both clamped to 16 bits).
+   */
+  struct QuantizedControllerState {
+    uint64_t sequence = 0;
+    uint8_t timer = 0;
+    uint8_t battery = 0;
+    uint32_t buttons = 0;
+    int16_t sticks[4] = { 0, 0, 0, 0 };
+    int16_t accelerometer[3] = { 0, 0, 0 };
+    int16_t gyroscope[3] = { 0, 0, 0 };
+
+    static QuantizedControllerState fromState(const ControllerState& state);
+    ControllerState toState() const;
+  };
+  /*
+   * Encodes controller states as deltas against the last state the receiver acknowledged.
+   *
+   * Frame format (version 1): a version byte, the frame number and the base frame number
+   * (both varints; base 0 means "against an all-zero state"), a byte flagging which
+   * fields changed, then the report sequence delta and each changed field: the button
+   * mask XORed with the base's, and zigzag varint deltas for everything else.
+   *
+   * Until a frame is acknowledged, every frame is encoded against the all-zero state,
+   * so a receiver can always decode it.
+   */
+  class JOYTIME_CORE_EXPORT StateDeltaEncoder {
+    private:
+      QuantizedControllerState history[64];
+      uint32_t historyFrames[64] = { 0 };
+      uint32_t frame = 0;
+      uint32_t acknowledged = 0;
+    public:
+      // returns the number of bytes written, or 0 if `capacity` is too small
+      size_t encode(const ControllerState& state, uint8_t* buffer, size_t capacity);
+      // the receiver decoded `frame`; later frames are encoded against it.
+      // frames older than the last 64 encoded are ignored
+      void acknowledge(uint32_t frame);
+      // makes the next frames self-contained again (e.g. for a new receiver)
+      void reset();
+
+      static const uint8_t version = 1;
+      // the largest a single encoded frame can get
+      static const size_t maxFrameSize = 64;
+  };
+  class JOYTIME_CORE_EXPORT StateDeltaDecoder {
+    private:
+      QuantizedControllerState history[64];
+      uint32_t historyFrames[64] = { 0 };
+      uint32_t latest = 0;
+    public:
+      // returns false if the frame is malformed, from a different format version or
+      // based on a frame this decoder doesn't have (anymore)
+      bool decode(const uint8_t* data, size_t size, ControllerState& state);
+      // the number of the last frame decoded, to acknowledge to the encoder
+      uint32_t lastFrame() const;
+      void reset();
+  };
+  /*
+   * An encoder and a decoder wired back to back in memory, for testing the codec
+   * (and whatever sits on top of it) without a network.
+   */
+  class JOYTIME_CORE_EXPORT StateDeltaLoopback {
+    private:
+      uint8_t buffer[StateDeltaEncoder::maxFrameSize];
+    public:
+      StateDeltaEncoder encoder;
+      StateDeltaDecoder decoder;
+      // size of the last encoded frame
+      size_t lastFrameSize = 0;
+
+      // encodes `in`, decodes it into `out` and, if `acknowledge` is set, acknowledges it.
+      // returns whether decoding succeeded
+      bool transfer(const ControllerState& in, ControllerState& out, bool acknowledge = true);
+  };
+
+  /*
+   * Brings up controllers on a pool of worker threads, so a batch of newly
+   * connected controllers is initialized concurrently instead of one by one.
+   * Each controller is announced on `ready` as soon as its own initialization
+   * finishes; one that fails is announced on `failed` and doesn't hold up the rest.
+   *
+   * By default, every controller emitted on `controllerAvailable` is added
+   * automatically, and controllers emitted on `controllerRemoved` before their
+   * turn are skipped.
+   *
+   * Controllers that never reply would hold up a worker forever, so each one is
+   * initialized with a timeout of `subcommandTimeout` milliseconds per subcommand
+   * (see `Controller::initialize`). The controller's own `subcommandTimeout` isn't touched.
+   */
+  class JOYTIME_CORE_EXPORT FleetInitializer {
+    private:
+      std::mutex mutex;
+      std::condition_variable wake;
+      std::condition_variable idle;
+      std::condition_variable finished;
+      std::deque<Controller*> pending;
+      // controllers being initialized, and the worker initializing each
+      std::vector<std::pair<Controller*, std::thread::id>> initializing;
+      std::vector<std::thread> workers;
+      size_t active = 0;
+      bool stopping = false;
+      bool attached = false;
+      unsigned int availableHandler = 0;
+      unsigned int removedHandler = 0;
+
+      void work();
+    public:
+      // whether to read the calibration data too (see `Controller::initialize`)
+      bool calibrate;
+      // timeout for each subcommand sent while initializing a controller, in milliseconds.
+      // 0 uses the controller's own `subcommandTimeout`
+      int subcommandTimeout = defaultSubcommandTimeout;
+
+      EventEmitter<Controller*> ready;
+      EventEmitter<Controller*> failed;
+
+      FleetInitializer(size_t workerCount = defaultWorkerCount, bool calibrate = true, bool attach = true);
+      FleetInitializer(const FleetInitializer&) = delete;
+      FleetInitializer& operator=(const FleetInitializer&) = delete;
+      // stops listening for new controllers and waits for the ones being initialized
+      ~FleetInitializer();
+
+      // queues a controller for initialization
+      void add(Controller* controller);
+      // drops a queued controller. if a worker is already initializing it, waits for
+      // that to finish (at most about `subcommandTimeout` per subcommand), so it can be
+      // destroyed as soon as this returns. `ready` and `failed` listeners can call this
+      void remove(Controller* controller);
+      // blocks until every queued controller has been initialized (or has failed)
+      void wait();
+
+      // initialization is mostly waiting on replies, so there can be more workers than cores
+      static const size_t defaultWorkerCount = 8;
+      static const int defaultSubcommandTimeout = 1000;
+  };
+
+  // what a HealthMonitor knows about one controller
+  struct ControllerHealth {
+    // device info is fetched once, as soon as the controller is usable
+    bool deviceInfoKnown = false;
+    DeviceInfo deviceInfo;
+    // only meaningful once a report has been received
+    ControllerBatteryStatus battery = ControllerBatteryStatus::Empty;
+    std::chrono::steady_clock::time_point batteryUpdatedAt;
+    uint64_t reports = 0;
+    // reports the controller sent that never arrived, judging by gaps in the report timer
+    uint64_t missedReports = 0;
+    // moving average of the share of reports that arrived (1 = none missed)
+    double linkQuality = 1.0;
+    std::chrono::steady_clock::time_point lastReportAt;
+    // link quality below `HealthMonitor::degradedThreshold`
+    bool degraded = false;
+    // no reports for `HealthMonitor::lostTimeout` milliseconds, even after a probe
+    bool lost = false;
+  };
+
+  /*
+   * Keeps track of the battery and link quality of a set of controllers, for
+   * managing large fleets. Almost everything is worked out from the reports the
+   * controllers already send; the only extra subcommands are one GetDeviceInfo per
+   * controller and, if a controller has been quiet for `probeTimeout` milliseconds
+   * (e.g. in low-power mode) or its battery hasn't been seen in
+   * `batteryRefreshInterval` milliseconds, a GetOnlyControllerState probe.
+   *
+   * Replies are read by whoever is already reading the controllers' reports
+   * (`poll`, `update` or `receiveReports`); the monitor never reads from a transport.
+   * Its own thread only checks timeouts every `checkInterval` milliseconds. Its
+   * subcommands give up after `probeTimeout` milliseconds, whatever the controller's
+   * `subcommandTimeout` is, so a quiet controller's queue isn't blocked for good.
+   *
+   * Events are emitted on whichever thread notices the change: the decoding thread
+   * for `batteryLow` and `connectionDegraded`/`connectionRestored` after a report,
+   * and the monitor's thread for `connectionLost`. `connectionRestored` follows
+   * both `connectionDegraded` and `connectionLost`.
+   *
+   * Controllers must be removed (or the monitor destroyed) before they're destroyed.
+   * By default, controllers emitted on `controllerAvailable` and `controllerRemoved`
+   * are added and removed automatically.
+   */
+  class JOYTIME_CORE_EXPORT HealthMonitor {
+    private:
+      struct Entry;
+
+      mutable std::mutex mutex;
+      std::condition_variable wake;
+      std::unordered_map<Controller*, std::shared_ptr<Entry>> entries;
+      std::thread checker;
+      bool stopping = false;
+      bool attached = false;
+      unsigned int availableHandler = 0;
+      unsigned int removedHandler = 0;
+
+      void check();
+      void checkEntry(const std::shared_ptr<Entry>& entry, std::chrono::steady_clock::time_point now);
+      void reportReceived(const std::shared_ptr<Entry>& entry);
+    public:
+      // in milliseconds
+      int checkInterval = defaultCheckInterval;
+      int probeTimeout = defaultProbeTimeout;
+      int lostTimeout = defaultLostTimeout;
+      int batteryRefreshInterval = defaultBatteryRefreshInterval;
+      double degradedThreshold = defaultDegradedThreshold;
+      // `batteryLow` fires when the battery drops to this level or below (while not charging)
+      ControllerBatteryStatus lowBatteryThreshold = ControllerBatteryStatus::Low;
+
+      EventEmitter<Controller*> batteryLow;
+      EventEmitter<Controller*> connectionDegraded;
+      EventEmitter<Controller*> connectionLost;
+      EventEmitter<Controller*> connectionRestored;
+
+      explicit HealthMonitor(bool attach = true);
+      HealthMonitor(const HealthMonitor&) = delete;
+      HealthMonitor& operator=(const HealthMonitor&) = delete;
+      // stops the checker thread and stops listening to every controller
+      ~HealthMonitor();
+
+      void add(Controller* controller);
+      void remove(Controller* controller);
+      // copies the health of `controller` into `health`. returns false if it isn't monitored
+      bool health(Controller* controller, ControllerHealth& health) const;
+      // the controllers that are currently degraded or lost
+      std::vector<Controller*> unhealthy() const;
+
+      static const int defaultCheckInterval = 250;
+      static const int defaultProbeTimeout = 2000;
+      static const int defaultLostTimeout = 5000;
+      static const int defaultBatteryRefreshInterval = 60000;
+      static constexpr double defaultDegradedThreshold = 0.9;
+  };
+
+  // the same as `Rumble(320.0, 0.0, 160.0, 0.0)`, i.e. the motors at rest
+  constexpr EncodedRumble neutralRumbleEncoded = { 0x00, 0x01, 0x40, 0x40 };
+
+  /*
+   * Stands in for the old `std::vector<uint8_t> neutralRumbleVector` global, which
+   * needed a dynamic initializer. It reads like the old vector (and converts to a copy
+   * of one), but can't be modified.
+   */
+  struct NeutralRumbleVector {
+    constexpr const uint8_t* data() const {
+      return neutralRumbleEncoded.data();
+    };
+    constexpr size_t size() const {
+      return neutralRumbleEncoded.size();
+    };
+    constexpr const uint8_t* begin() const {
+      return data();
+    };
+    constexpr const uint8_t* end() const {
+      return data() + size();
+    };
+    constexpr uint8_t operator[](size_t i) const {
+      return neutralRumbleEncoded[i];
+    };
+    operator std::vector<uint8_t>() const {
+      return std::vector<uint8_t>(begin(), end());
+    };
+  };
+
+  [[deprecated("use neutralRumbleEncoded instead")]] constexpr NeutralRumbleVector neutralRumbleVector {};
+
   JOYTIME_CORE_EXPORT extern Joytime::Rumble neutralRumble;
   JOYTIME_CORE_EXPORT extern uint8_t* neutralRumbleBuffer;
-  JOYTIME_CORE_EXPORT extern std::vector<uint8_t> neutralRumbleVector;
+  // created on first use
+  JOYTIME_CORE_EXPORT EventEmitter<Joytime::Controller*>& controllerAvailable();
+  JOYTIME_CORE_EXPORT EventEmitter<Joytime::Controller*>& controllerRemoved();
 }
 
 #endif /* JOYTIME_CORE_HPP */
@@ -0,0 +1,128 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+Joytime::CombinedController::CombinedController(Joytime::Controller* _left, Joytime::Controller* _right):
+  left(_left),
+  right(_right) {
+  if (left == nullptr || left->type != Joytime::ControllerType::LeftJoycon) throw std::runtime_error("Could not combine controllers: the left controller is not a Left JoyCon.");
+  if (right == nullptr || right->type != Joytime::ControllerType::RightJoycon) throw std::runtime_error("Could not combine controllers: the right controller is not a Right JoyCon.");
+
+  leftHandler = left->updated.on([this](Joytime::Controller* controller) {
+    merge(controller);
+  });
+  rightHandler = right->updated.on([this](Joytime::Controller* controller) {
+    merge(controller);
+  });
+};
+
+Joytime::CombinedController::~CombinedController() {
+  left->updated.removeHandler(leftHandler);
+  right->updated.removeHandler(rightHandler);
+};
+
+Joytime::Controller* Joytime::CombinedController::leftController() const {
+  return left;
+};
+
+Joytime::Controller* Joytime::CombinedController::rightController() const {
+  return right;
+};
+
+uint64_t Joytime::CombinedController::advance(uint64_t ticks, uint8_t previousTimer, uint8_t timer, bool& started) {
+  // each side's count starts at its first report
+  if (!started) {
+    started = true;
+    return ticks;
+  }
+
+  // the timer is 8 bits wide and wraps around. reports without a timer
+  // (SimpleHID) leave it unchanged, so count those as one tick
+  uint8_t elapsed = timer - previousTimer;
+  return ticks + std::max(elapsed, (uint8_t)1);
+};
+
+void Joytime::CombinedController::merge(Joytime::Controller* controller) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (controller == left) {
+      leftTicks = advance(leftTicks, merging.leftTimer, controller->timer, leftStarted);
+      merging.leftTimer = controller->timer;
+      merging.leftBattery = controller->battery;
+
+      merging.buttons.up = controller->buttons.up;
+      merging.buttons.down = controller->buttons.down;
+      merging.buttons.left = controller->buttons.left;
+      merging.buttons.right = controller->buttons.right;
+      merging.buttons.l = controller->buttons.l;
+      merging.buttons.zl = controller->buttons.zl;
+      merging.buttons.minus = controller->buttons.minus;
+      merging.buttons.lStick = controller->buttons.lStick;
+      merging.buttons.capture = controller->buttons.capture;
+      sideRails[0] = controller->buttons.sl;
+      sideRails[1] = controller->buttons.sr;
+
+      merging.leftStick = controller->leftStick;
+      merging.leftAccelerometer = controller->accelerometer;
+      merging.leftGyroscope = controller->gyroscope;
+    } else {
+      rightTicks = advance(rightTicks, merging.rightTimer, controller->timer, rightStarted);
+      merging.rightTimer = controller->timer;
+      merging.rightBattery = controller->battery;
+
+      merging.buttons.a = controller->buttons.a;
+      merging.buttons.b = controller->buttons.b;
+      merging.buttons.x = controller->buttons.x;
+      merging.buttons.y = controller->buttons.y;
+      merging.buttons.r = controller->buttons.r;
+      merging.buttons.zr = controller->buttons.zr;
+      merging.buttons.plus = controller->buttons.plus;
+      merging.buttons.rStick = controller->buttons.rStick;
+      merging.buttons.home = controller->buttons.home;
+      sideRails[2] = controller->buttons.sl;
+      sideRails[3] = controller->buttons.sr;
+
+      merging.rightStick = controller->rightStick;
+      merging.rightAccelerometer = controller->accelerometer;
+      merging.rightGyroscope = controller->gyroscope;
+    }
+
+    // SL/SR are pressed if they're pressed on either side
+    merging.buttons.sl = sideRails[0] || sideRails[2];
+    merging.buttons.sr = sideRails[1] || sideRails[3];
+
+    if (!leftStarted || !rightStarted) return;
+
+    uint64_t behind = std::min(leftTicks, rightTicks);
+    uint64_t ahead = std::max(leftTicks, rightTicks);
+
+    if (behind > mergedTicks) {
+      mergedTicks = behind;
+    } else if (ahead - behind <= maxTimerSkew) {
+      // still waiting for the other side's report for this stretch of time
+      return;
+    }
+
+    merging.sequence++;
+    published = merging;
+  }
+
+  updated.emit(this);
+};
+
+Joytime::CombinedControllerState Joytime::CombinedController::snapshot() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return published;
+};
+
+void Joytime::CombinedController::rumble(uint8_t timing, Joytime::Rumble* leftRumble, Joytime::Rumble* rightRumble) {
+  left->rumble(timing, leftRumble);
+  right->rumble(timing, rightRumble);
+};
+
+void Joytime::CombinedController::rumble(uint8_t timing, Joytime::Rumble* _rumble) {
+  rumble(timing, _rumble, _rumble);
+};
@@ -1,115 +1,247 @@
 #include "joytime-core.hpp"
+#include "joytime-core-basic.hpp"
 #include <cstdint>
-#include <iostream>
 #include <vector>
+#include <cstring>
 #include <exception>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 
 Joytime::Controller::Controller():
   initializable(false) {};
 
 Joytime::Controller::Controller(const Joytime::Controller& controller):
-  transmitBuffer(controller.transmitBuffer),
-  receiveBuffer(controller.receiveBuffer),
-  transmitBufferC(controller.transmitBufferC),
-  receiveBufferC(controller.receiveBufferC),
-  type(controller.type),
-  handle(controller.handle),
+  transport(controller.transport),
+  usable(controller.usable.load()),
   initializable(controller.initializable),
-  usable(controller.usable) {};
+  handle(controller.handle),
+  type(controller.type) {};
 
 Joytime::Controller::Controller(Joytime::ControllerType _type, void* _handle, Joytime::TransmitBufferFunction* _transmitBuffer, Joytime::ReceiveBufferFunction* _receiveBuffer):
-  transmitBuffer(_transmitBuffer),
-  receiveBuffer(_receiveBuffer),
+  transport(std::make_shared<Joytime::CallbackTransport>(_handle, _transmitBuffer, _receiveBuffer)),
   type(_type),
   handle(_handle) {};
 
 Joytime::Controller::Controller(Joytime::ControllerType _type, void* _handle, Joytime::CTransmitBufferFunction* _transmitBufferC, Joytime::CReceiveBufferFunction* _receiveBufferC):
-  transmitBufferC(_transmitBufferC),
-  receiveBufferC(_receiveBufferC),
+  transport(std::make_shared<Joytime::CallbackTransport>(_handle, _transmitBufferC, _receiveBufferC)),
   type(_type),
   handle(_handle) {};
 
-void Joytime::Controller::transmitBuffer_(std::vector<uint8_t> buffer) {
-  if (transmitBuffer != nullptr) {
-    transmitBuffer(handle, buffer);
-  } else if (transmitBufferC != nullptr) {
-    transmitBufferC(handle, buffer.data(), buffer.size());
-  } else {
-    throw std::runtime_error("Could not send command: no transmission function is set.");
-  }
+Joytime::Controller::Controller(Joytime::ControllerType _type, void* _handle, Joytime::Transport* _transport):
+  // non-owning: the deleter is a no-op
+  transport(_transport, [](Joytime::Transport*) {}),
+  type(_type),
+  handle(_handle) {};
+
+Joytime::Controller::Controller(Joytime::ControllerType _type, void* _handle, std::shared_ptr<Joytime::Transport> _transport):
+  transport(_transport),
+  type(_type),
+  handle(_handle) {};
+
+void Joytime::Controller::transmitBuffer_(const uint8_t* buffer, size_t size) {
+  if (!transport) throw std::runtime_error("Could not send command: no transmission function is set.");
+
+  std::lock_guard<std::mutex> lock(transmitMutex);
+  if (transport->send(buffer, size) < 0) throw std::runtime_error("Could not send command: the transport failed to send it.");
 };
 
-std::vector<uint8_t> Joytime::Controller::receiveResponse_() {
-  std::vector<uint8_t> response;
+size_t Joytime::Controller::receiveResponse_(uint8_t* buffer, size_t capacity) {
+  if (!transport) throw std::runtime_error("Could not send command: no receive function is set.");
 
-  if (receiveBuffer != nullptr) {
-    std::vector<uint8_t> tmp;
-    while ((tmp = receiveBuffer(handle, 50)), tmp.size() > 0) {
-      response.insert(response.end(), tmp.begin(), tmp.end());
-    }
-  } else if (receiveBufferC != nullptr) {
-    uint8_t* tmp;
-    int bytesRead = 0;
-    while ((tmp = receiveBufferC(handle, 50, &bytesRead)), bytesRead > 0) {
-      for (int i = 0; i < bytesRead; i++) {
-        response.push_back(tmp[i]);
-      }
+  int bytesRead = transport->receive(buffer, capacity, 50);
+  if (bytesRead < 0) throw std::runtime_error("Could not receive reply: the transport failed to receive it.");
+
+  // never trust a transport to stay within the buffer it was given
+  return std::min((size_t)bytesRead, capacity);
+};
+
+// how long `sendCommand` waits for any reply, in milliseconds
+static const int commandReplyTimeout = 1000;
+
+uint8_t Joytime::Controller::nextPacketCounter() {
+  // the counter wraps at 0x100, which keeps the low nibble cycling through 0x0-0xf
+  return counter.fetch_add(1, std::memory_order_relaxed) & 0xf;
+};
+
+void Joytime::Controller::transmitNextSubcommand(std::unique_lock<std::mutex>& lock) {
+  while (!subcommandInFlight && !subcommandQueue.empty()) {
+    QueuedSubcommand& next = subcommandQueue.front();
+
+    uint8_t buf[Joytime::Transport::maxPacketSize];
+    size_t size = std::min(next.data.size(), sizeof(buf) - 11);
+
+    buf[0] = (uint8_t)next.command;
+    buf[1] = nextPacketCounter();
+
+    memcpy(buf + 2, Joytime::neutralRumbleEncoded.data(), 4);
+    memcpy(buf + 6, Joytime::neutralRumbleEncoded.data(), 4);
+
+    buf[10] = next.subcommand;
+
+    if (size > 0) memcpy(buf + 11, next.data.data(), size);
+
+    subcommandInFlight = true;
+    subcommandSentAt = std::chrono::steady_clock::now();
+
+    try {
+      transmitBuffer_(buf, size + 11);
+      counters.subcommandsSent.fetch_add(1, std::memory_order_relaxed);
+    } catch (...) {
+      failInFlightSubcommand(lock);
     }
-  } else {
-    throw std::runtime_error("Could not send command: no receive function is set.");
   }
+};
 
-  return response;
+void Joytime::Controller::failInFlightSubcommand(std::unique_lock<std::mutex>& lock) {
+  Joytime::SubcommandCallback callback = std::move(subcommandQueue.front().callback);
+  subcommandQueue.pop_front();
+  subcommandInFlight = false;
+  counters.subcommandsFailed.fetch_add(1, std::memory_order_relaxed);
+
+  lock.unlock();
+  if (callback) callback(this, nullptr, 0);
+  lock.lock();
 };
 
-std::vector<uint8_t> Joytime::Controller::sendCommand(Joytime::ControllerCommand command, std::vector<uint8_t> buffer) {
-  std::vector<uint8_t> buf;
+void Joytime::Controller::checkSubcommandTimeout() {
+  std::unique_lock<std::mutex> lock(subcommandMutex);
+  if (!subcommandInFlight) return;
 
-  buf.push_back((uint8_t)command);
-  buf.insert(buf.begin() + 1, buffer.begin(), buffer.end());
+  int timeout = subcommandQueue.front().timeout;
+  if (timeout <= 0) timeout = subcommandTimeout;
+  if (timeout <= 0) return;
+  if (std::chrono::steady_clock::now() - subcommandSentAt < std::chrono::milliseconds(timeout)) return;
 
-  transmitBuffer_(buf);
+  failInFlightSubcommand(lock);
+  transmitNextSubcommand(lock);
+};
 
-  // read until a reply is received
-  std::vector<uint8_t> reply;
-  while ((reply = receiveResponse_()), reply.size() < 1);
+void Joytime::Controller::routeReport(const uint8_t* buf, size_t size) {
+  if (size < 15 || buf[0] != (uint8_t)Joytime::ControllerReportCode::SubcommandReply) return;
 
-  return reply;
+  std::unique_lock<std::mutex> lock(subcommandMutex);
+  if (!subcommandInFlight || buf[14] != subcommandQueue.front().subcommand) return;
+
+  Joytime::SubcommandCallback callback = std::move(subcommandQueue.front().callback);
+  subcommandQueue.pop_front();
+  subcommandInFlight = false;
+
+  // get the next one going before handing over the reply
+  transmitNextSubcommand(lock);
+  lock.unlock();
+
+  if (callback) callback(this, buf, size);
 };
 
-std::vector<uint8_t> Joytime::Controller::sendSubcommand(Joytime::ControllerCommand command, Joytime::ControllerSubcommand subcommand, std::vector<uint8_t> buffer) {
-  std::vector<uint8_t> buf;
+void Joytime::Controller::routeReport(void* controller, const uint8_t* buf, size_t size) {
+  ((Joytime::Controller*)controller)->routeReport(buf, size);
+};
 
-  buf.push_back((uint8_t)command);
+size_t Joytime::Controller::sendCommand(Joytime::ControllerCommand command, const uint8_t* data, size_t size, uint8_t* reply) {
+  uint8_t buf[Joytime::Transport::maxPacketSize];
+  if (size + 1 > sizeof(buf)) throw std::runtime_error("Could not send command: it's too large.");
 
-  buf.push_back(counter);
-  counter++;
-  if (counter > 0xf) counter = 0;
+  buf[0] = (uint8_t)command;
+  if (size > 0) memcpy(buf + 1, data, size);
 
-  buf.insert(buf.begin() + 2, Joytime::neutralRumbleVector.begin(), Joytime::neutralRumbleVector.end());
-  buf.insert(buf.begin() + 6, Joytime::neutralRumbleVector.begin(), Joytime::neutralRumbleVector.end());
+  transmitBuffer_(buf, size + 1);
 
-  buf.push_back((uint8_t)subcommand);
+  // if another thread is already reading from the transport (or the report queue
+  // is in use), the reply will be decoded over there instead. otherwise, it's decoded here
+  if (reportQueue) return 0;
+  std::unique_lock<std::mutex> receiveLock(receiveMutex, std::try_to_lock);
+  if (!receiveLock.owns_lock()) return 0;
 
-  buf.insert(buf.begin() + 11, buffer.begin(), buffer.end());
+  // read until a reply is received. another thread may have grabbed it in the
+  // meantime, so don't wait forever
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(commandReplyTimeout);
+  size_t replySize;
+  while ((replySize = receiveResponse_(reply, Joytime::Transport::maxPacketSize)), replySize < 1) {
+    if (std::chrono::steady_clock::now() > deadline) return 0;
+  }
+  receiveLock.unlock();
 
-  transmitBuffer_(buf);
+  routeReport(reply, replySize);
+  update(reply, replySize);
+
+  return replySize;
+};
+
+void Joytime::Controller::sendSubcommandAsync(Joytime::ControllerSubcommand subcommand, const uint8_t* data, size_t size, Joytime::SubcommandCallback callback, int timeout) {
+  sendSubcommandAsync(Joytime::ControllerCommand::RumbleAndSubcommand, subcommand, data, size, callback, timeout);
+};
 
-  // read until the *correct subcommand reply* is received
-  std::vector<uint8_t> reply;
+void Joytime::Controller::sendSubcommandAsync(Joytime::ControllerCommand command, Joytime::ControllerSubcommand subcommand, const uint8_t* data, size_t size, Joytime::SubcommandCallback callback, int timeout) {
+  if (size + 11 > Joytime::Transport::maxPacketSize) throw std::runtime_error("Could not send subcommand: it's too large.");
+
+  QueuedSubcommand queued;
+  queued.command = command;
+  queued.subcommand = (uint8_t)subcommand;
+  queued.data.assign(data, data + size);
+  queued.callback = std::move(callback);
+  queued.timeout = timeout;
+
+  std::unique_lock<std::mutex> lock(subcommandMutex);
+  subcommandQueue.push_back(std::move(queued));
+  transmitNextSubcommand(lock);
+};
+
+size_t Joytime::Controller::sendSubcommand(Joytime::ControllerCommand command, Joytime::ControllerSubcommand subcommand, const uint8_t* data, size_t size, uint8_t* reply, int timeout) {
+  // shared with the callback, which might outlive this call if the transport throws
+  struct Waiter {
+    std::mutex mutex;
+    std::condition_variable replied;
+    bool done = false;
+    size_t size = 0;
+    uint8_t reply[Joytime::Transport::maxPacketSize];
+  };
+  std::shared_ptr<Waiter> waiter = std::make_shared<Waiter>();
+
+  sendSubcommandAsync(command, subcommand, data, size, [waiter](Joytime::Controller*, const uint8_t* buf, size_t bufSize) {
+    std::lock_guard<std::mutex> lock(waiter->mutex);
+    bufSize = std::min(bufSize, sizeof(waiter->reply));
+    if (buf != nullptr) memcpy(waiter->reply, buf, bufSize);
+    waiter->size = bufSize;
+    waiter->done = true;
+    waiter->replied.notify_all();
+  }, timeout);
+
+  // wait until the *correct subcommand reply* is received, either by reading it
+  // ourselves or by having whichever thread is reading the transport hand it over
   while (true) {
-    reply = receiveResponse_();
-    if (reply.size() < 1) continue;
-    if (reply[0] != (uint8_t)Joytime::ControllerReportCode::SubcommandReply) continue;
-    if (reply[14] != (uint8_t)subcommand) continue;
-    break;
+    if (reportQueue) {
+      std::unique_lock<std::mutex> lock(waiter->mutex);
+      if (waiter->replied.wait_for(lock, std::chrono::milliseconds(10), [&waiter]() { return waiter->done; })) break;
+    } else {
+      uint8_t response[Joytime::Transport::maxPacketSize];
+      size_t responseSize;
+      {
+        std::lock_guard<std::mutex> receiveLock(receiveMutex);
+        {
+          std::lock_guard<std::mutex> lock(waiter->mutex);
+          if (waiter->done) break;
+        }
+        responseSize = receiveResponse_(response, sizeof(response));
+      }
+      // anything else that comes in is still input, so decode it too
+      routeReport(response, responseSize);
+      if (responseSize > 0) update(response, responseSize);
+    }
+
+    checkSubcommandTimeout();
   };
 
-  return reply;
+  std::lock_guard<std::mutex> lock(waiter->mutex);
+  if (waiter->size == 0) throw std::runtime_error("Subcommand failed: no reply was received.");
+
+  memcpy(reply, waiter->reply, waiter->size);
+  return waiter->size;
 };
 
-std::vector<uint8_t> Joytime::Controller::readSPIFlash(int32_t address, uint8_t length) {
-  std::vector<uint8_t> buf = {
+std::vector<uint8_t> Joytime::Controller::readSPIFlash(int32_t address, uint8_t length, int timeout) {
+  uint8_t buf[] = {
     (uint8_t)((address) & 0xff),
     (uint8_t)((address >> 8) & 0xff),
     (uint8_t)((address >> 16) & 0xff),
@@ -117,198 +249,420 @@ std::vector<uint8_t> Joytime::Controller::readSPIFlash(int32_t address, uint8_t
     length
   };
 
-  std::vector<uint8_t> res = sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::ReadSPIFlash, buf);
-  if (res.size() < 20) return std::vector<uint8_t>();
+  uint8_t res[Joytime::Transport::maxPacketSize];
+  size_t resSize = sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::ReadSPIFlash, buf, sizeof(buf), res, timeout);
+  if (resSize < 20) return std::vector<uint8_t>();
 
   // offset 20, explained:
   // 15 - subcommand response data starts at 15
   // 4  - 4 bytes for the address read
   // 1  - 1 byte for length
-  return std::vector<uint8_t>(res.begin() + 20, res.end());
+  return std::vector<uint8_t>(res + 20, res + resSize);
+};
+
+void Joytime::Controller::readSPIFlashAsync(int32_t address, uint8_t length, Joytime::SPIFlashCallback callback) {
+  performUsabilityCheck();
+  uint8_t buf[] = {
+    (uint8_t)((address) & 0xff),
+    (uint8_t)((address >> 8) & 0xff),
+    (uint8_t)((address >> 16) & 0xff),
+    (uint8_t)((address >> 24) & 0xff),
+    length
+  };
+
+  sendSubcommandAsync(Joytime::ControllerSubcommand::ReadSPIFlash, buf, sizeof(buf), [callback](Joytime::Controller* controller, const uint8_t* res, size_t resSize) {
+    if (!callback) return;
+    // same offset as `readSPIFlash`
+    if (res == nullptr || resSize < 20) return callback(controller, nullptr, 0);
+    callback(controller, res + 20, resSize - 20);
+  });
 };
 
-void Joytime::Controller::initialize(bool calibrate) {
+// GetDeviceInfo reply data, from offset 15: firmware version (2 bytes), type, an unknown byte, then the MAC
+static const size_t deviceInfoReplySize = 25;
+
+static Joytime::DeviceInfo parseDeviceInfo(const uint8_t* res) {
+  Joytime::DeviceInfo info;
+  info.firmwareMajor = res[15];
+  info.firmwareMinor = res[16];
+  info.type = res[17];
+  memcpy(info.mac, res + 19, sizeof(info.mac));
+  return info;
+};
+
+Joytime::DeviceInfo Joytime::Controller::getDeviceInfo(int timeout) {
+  uint8_t res[Joytime::Transport::maxPacketSize];
+  size_t resSize = sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::GetDeviceInfo, nullptr, 0, res, timeout);
+  if (resSize < deviceInfoReplySize) throw std::runtime_error("Could not get device info: no complete reply was received.");
+
+  return parseDeviceInfo(res);
+};
+
+void Joytime::Controller::getDeviceInfoAsync(Joytime::DeviceInfoCallback callback, int timeout) {
+  performUsabilityCheck();
+  sendSubcommandAsync(Joytime::ControllerSubcommand::GetDeviceInfo, nullptr, 0, [callback](Joytime::Controller* controller, const uint8_t* res, size_t resSize) {
+    if (!callback) return;
+    if (res == nullptr || resSize < deviceInfoReplySize) return callback(controller, nullptr);
+    Joytime::DeviceInfo info = parseDeviceInfo(res);
+    callback(controller, &info);
+  }, timeout);
+};
+
+// SPI flash reads needed for calibration, in the order `applyCalibration` takes them
+static const struct {
+  int32_t address;
+  uint8_t length;
+} calibrationReads[Joytime::Controller::calibrationReadCount] = {
+  { 0x6020, 24 }, // six-axis calibration
+  { 0x603d, 9 },  // left stick calibration
+  { 0x6046, 9 },  // right stick calibration
+  { 0x6080, 6 },  // six-axis parameters
+  { 0x6086, 18 }, // stick parameters 1
+  { 0x6098, 18 }, // stick parameters 2
+};
+
+void Joytime::Controller::initialize(bool calibrate, int timeout) {
   if (!initializable) throw std::runtime_error("This Controller cannot be initialized");
 
   usable = true;
 
-  setInputReportMode(Joytime::ControllerInputReportMode::StandardReport);
-  setVibration(true);
-  setSixAxisEnabled(true);
-
-  if (calibrate) {
-    std::vector<uint8_t> sixAxisCalibrationBuf = readSPIFlash(0x6020, 24);
-    std::vector<uint8_t> leftStickCalibrationBuf = readSPIFlash(0x603d, 9);
-    std::vector<uint8_t> rightStickCalibrationBuf = readSPIFlash(0x6046, 9);
-    std::vector<uint8_t> sixAxisParametersBuf = readSPIFlash(0x6080, 6);
-    std::vector<uint8_t> stickParameters1Buf = readSPIFlash(0x6086, 18);
-    std::vector<uint8_t> stickParameters2Buf = readSPIFlash(0x6098, 18);
-
-    if (leftStickCalibrationBuf.size() >= 0x09) {
-      uint16_t leftStickData[6] = {
-        ((leftStickCalibrationBuf[1] << 8) & 0xf00) | leftStickCalibrationBuf[0],
-        (leftStickCalibrationBuf[2] << 4) | (leftStickCalibrationBuf[1] >> 4),
-        ((leftStickCalibrationBuf[4] << 8) & 0xf00) | leftStickCalibrationBuf[3],
-        (leftStickCalibrationBuf[5] << 4) | (leftStickCalibrationBuf[4] >> 4),
-        ((leftStickCalibrationBuf[7] << 8) & 0xf00) | leftStickCalibrationBuf[6],
-        (leftStickCalibrationBuf[8] << 4) | (leftStickCalibrationBuf[7] >> 4)
-      };
-
-      uint16_t leftStickParameters[12] = {
-        ((stickParameters1Buf[1] << 8) & 0xf00) | stickParameters1Buf[0],
-        (stickParameters1Buf[2] << 4) | (stickParameters1Buf[1] >> 4),
-        ((stickParameters1Buf[4] << 8) & 0xf00) | stickParameters1Buf[3],
-        (stickParameters1Buf[5] << 4) | (stickParameters1Buf[4] >> 4),
-        ((stickParameters1Buf[7] << 8) & 0xf00) | stickParameters1Buf[6],
-        (stickParameters1Buf[8] << 4) | (stickParameters1Buf[7] >> 4),
-        ((stickParameters1Buf[10] << 8) & 0xf00) | stickParameters1Buf[9],
-        (stickParameters1Buf[11] << 4) | (stickParameters1Buf[10] >> 4),
-        ((stickParameters1Buf[13] << 8) & 0xf00) | stickParameters1Buf[12],
-        (stickParameters1Buf[14] << 4) | (stickParameters1Buf[13] >> 4),
-        ((stickParameters1Buf[16] << 8) & 0xf00) | stickParameters1Buf[15],
-        (stickParameters1Buf[17] << 4) | (stickParameters1Buf[16] >> 4),
-      };
-
-      leftStickCalibration.xCenter = leftStickData[2];
-      leftStickCalibration.yCenter = leftStickData[3];
-      leftStickCalibration.xMax = leftStickData[0];
-      leftStickCalibration.yMax = leftStickData[1];
-      leftStickCalibration.xMin = leftStickData[4];
-      leftStickCalibration.yMin = leftStickData[5];
+  try {
+    // the same as setInputReportMode, setVibration and setSixAxisEnabled, with `timeout`
+    uint8_t reportMode[] = { (uint8_t)Joytime::ControllerInputReportMode::StandardReport };
+    uint8_t enable[] = { 1 };
+    uint8_t reply[Joytime::Transport::maxPacketSize];
+    sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetInputReportMode, reportMode, sizeof(reportMode), reply, timeout);
+    sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetVibration, enable, sizeof(enable), reply, timeout);
+    sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetSixAxisSensor, enable, sizeof(enable), reply, timeout);
+
+    if (calibrate) {
+      std::vector<uint8_t> buffers[calibrationReadCount];
+      for (size_t i = 0; i < calibrationReadCount; i++) {
+        buffers[i] = readSPIFlash(calibrationReads[i].address, calibrationReads[i].length, timeout);
+      }
+      applyCalibration(buffers);
+    }
+  } catch (...) {
+    // a half-initialized controller isn't usable
+    usable = false;
+    throw;
+  }
+};
+
+void Joytime::Controller::initializeAsync(bool calibrate, Joytime::CompletionCallback callback) {
+  if (!initializable) throw std::runtime_error("This Controller cannot be initialized");
+
+  usable = true;
+
+  struct InitializationState {
+    std::vector<uint8_t> buffers[calibrationReadCount];
+    bool failed = false;
+  };
+  std::shared_ptr<InitializationState> state = std::make_shared<InitializationState>();
+
+  // subcommands go out one after the other in the order they're queued,
+  // so only the last one needs to report completion
+  Joytime::CompletionCallback checkSuccess = [state](Joytime::Controller*, bool success) {
+    if (!success) state->failed = true;
+  };
+
+  setInputReportModeAsync(Joytime::ControllerInputReportMode::StandardReport, checkSuccess);
+  setVibrationAsync(true, checkSuccess);
+
+  if (!calibrate) {
+    setSixAxisEnabledAsync(true, [state, callback](Joytime::Controller* controller, bool success) {
+      success = success && !state->failed;
+      // a half-initialized controller isn't usable, just like with `initialize`
+      if (!success) controller->usable = false;
+      if (callback) callback(controller, success);
+    });
+    return;
+  }
+
+  setSixAxisEnabledAsync(true, checkSuccess);
+
+  for (size_t i = 0; i < calibrationReadCount; i++) {
+    bool last = i == calibrationReadCount - 1;
+    readSPIFlashAsync(calibrationReads[i].address, calibrationReads[i].length, [state, callback, i, last](Joytime::Controller* controller, const uint8_t* data, size_t size) {
+      if (data == nullptr) {
+        state->failed = true;
+      } else {
+        state->buffers[i].assign(data, data + size);
+      }
+
+      if (!last) return;
+
+      // a failed read leaves its buffer empty, so there's nothing to calibrate with
+      if (state->failed) {
+        controller->usable = false;
+      } else {
+        controller->applyCalibration(state->buffers);
+      }
+      if (callback) callback(controller, !state->failed);
+    });
+  }
+};
+
+// unpacks `count` 12-bit values, stored two to every three bytes. returns false if `buf` is too short
+static bool unpackCalibrationValues(const std::vector<uint8_t>& buf, uint16_t* values, size_t count) {
+  if (buf.size() < count / 2 * 3) return false;
+
+  for (size_t i = 0; i < count / 2; i++) {
+    const uint8_t* bytes = buf.data() + i * 3;
+    values[i * 2] = ((bytes[1] << 8) & 0xf00) | bytes[0];
+    values[i * 2 + 1] = (bytes[2] << 4) | (bytes[1] >> 4);
+  }
+
+  return true;
+};
+
+// a little endian int16_t at `offset`, which the caller has checked is in bounds
+static int16_t calibrationInt16(const std::vector<uint8_t>& buf, size_t offset) {
+  return (int16_t)((buf[offset + 1] << 8) | buf[offset]);
+};
+
+void Joytime::Controller::applyCalibration(const std::vector<uint8_t>* buffers) {
+  const std::vector<uint8_t>& sixAxisCalibrationBuf = buffers[0];
+  const std::vector<uint8_t>& leftStickCalibrationBuf = buffers[1];
+  const std::vector<uint8_t>& rightStickCalibrationBuf = buffers[2];
+  const std::vector<uint8_t>& sixAxisParametersBuf = buffers[3];
+  const std::vector<uint8_t>& stickParameters1Buf = buffers[4];
+  const std::vector<uint8_t>& stickParameters2Buf = buffers[5];
+
+  uint16_t leftStickData[6];
+  if (unpackCalibrationValues(leftStickCalibrationBuf, leftStickData, 6)) {
+    leftStickCalibration.xCenter = leftStickData[2];
+    leftStickCalibration.yCenter = leftStickData[3];
+    leftStickCalibration.xMax = leftStickData[0];
+    leftStickCalibration.yMax = leftStickData[1];
+    leftStickCalibration.xMin = leftStickData[4];
+    leftStickCalibration.yMin = leftStickData[5];
+
+    uint16_t leftStickParameters[12];
+    if (unpackCalibrationValues(stickParameters1Buf, leftStickParameters, 12)) {
       leftStickCalibration.deadZone = leftStickParameters[2];
       leftStickCalibration.rangeRatio = leftStickParameters[3];
     }
+  }
 
-    if (rightStickCalibrationBuf.size() >= 0x09) {
-      uint16_t rightStickData[6] = {
-        ((rightStickCalibrationBuf[1] << 8) & 0xf00) | rightStickCalibrationBuf[0],
-        (rightStickCalibrationBuf[2] << 4) | (rightStickCalibrationBuf[1] >> 4),
-        ((rightStickCalibrationBuf[4] << 8) & 0xf00) | rightStickCalibrationBuf[3],
-        (rightStickCalibrationBuf[5] << 4) | (rightStickCalibrationBuf[4] >> 4),
-        ((rightStickCalibrationBuf[7] << 8) & 0xf00) | rightStickCalibrationBuf[6],
-        (rightStickCalibrationBuf[8] << 4) | (rightStickCalibrationBuf[7] >> 4)
-      };
-
-      uint16_t rightStickParameters[12] = {
-        ((stickParameters2Buf[1] << 8) & 0xf00) | stickParameters2Buf[0],
-        (stickParameters2Buf[2] << 4) | (stickParameters2Buf[1] >> 4),
-        ((stickParameters2Buf[4] << 8) & 0xf00) | stickParameters2Buf[3],
-        (stickParameters2Buf[5] << 4) | (stickParameters2Buf[4] >> 4),
-        ((stickParameters2Buf[7] << 8) & 0xf00) | stickParameters2Buf[6],
-        (stickParameters2Buf[8] << 4) | (stickParameters2Buf[7] >> 4),
-        ((stickParameters2Buf[10] << 8) & 0xf00) | stickParameters2Buf[9],
-        (stickParameters2Buf[11] << 4) | (stickParameters2Buf[10] >> 4),
-        ((stickParameters2Buf[13] << 8) & 0xf00) | stickParameters2Buf[12],
-        (stickParameters2Buf[14] << 4) | (stickParameters2Buf[13] >> 4),
-        ((stickParameters2Buf[16] << 8) & 0xf00) | stickParameters2Buf[15],
-        (stickParameters2Buf[17] << 4) | (stickParameters2Buf[16] >> 4),
-      };
-
-      rightStickCalibration.xCenter = rightStickData[0];
-      rightStickCalibration.yCenter = rightStickData[1];
-      rightStickCalibration.xMax = rightStickData[4];
-      rightStickCalibration.yMax = rightStickData[5];
-      rightStickCalibration.xMin = rightStickData[2];
-      rightStickCalibration.yMin = rightStickData[3];
+  uint16_t rightStickData[6];
+  if (unpackCalibrationValues(rightStickCalibrationBuf, rightStickData, 6)) {
+    rightStickCalibration.xCenter = rightStickData[0];
+    rightStickCalibration.yCenter = rightStickData[1];
+    rightStickCalibration.xMax = rightStickData[4];
+    rightStickCalibration.yMax = rightStickData[5];
+    rightStickCalibration.xMin = rightStickData[2];
+    rightStickCalibration.yMin = rightStickData[3];
+
+    uint16_t rightStickParameters[12];
+    if (unpackCalibrationValues(stickParameters2Buf, rightStickParameters, 12)) {
       rightStickCalibration.deadZone = rightStickParameters[2];
       rightStickCalibration.rangeRatio = rightStickParameters[3];
     }
+  }
 
-    if (sixAxisCalibrationBuf.size() >= 0x18) {
-      accelerometerCalibration.originX = (sixAxisCalibrationBuf[1] << 8) | sixAxisCalibrationBuf[0];
-      accelerometerCalibration.originY = (sixAxisCalibrationBuf[3] << 8) | sixAxisCalibrationBuf[2];
-      accelerometerCalibration.originZ = (sixAxisCalibrationBuf[5] << 8) | sixAxisCalibrationBuf[4];
-      accelerometerCalibration.rawCoeffX = (sixAxisCalibrationBuf[7] << 8) | sixAxisCalibrationBuf[6];
-      accelerometerCalibration.rawCoeffY = (sixAxisCalibrationBuf[9] << 8) | sixAxisCalibrationBuf[8];
-      accelerometerCalibration.rawCoeffZ = (sixAxisCalibrationBuf[11] << 8) | sixAxisCalibrationBuf[10];
-
-      gyroscopeCalibration.originX = (sixAxisCalibrationBuf[13] << 8) | sixAxisCalibrationBuf[12];
-      gyroscopeCalibration.originY = (sixAxisCalibrationBuf[15] << 8) | sixAxisCalibrationBuf[14];
-      gyroscopeCalibration.originZ = (sixAxisCalibrationBuf[17] << 8) | sixAxisCalibrationBuf[16];
-      gyroscopeCalibration.rawCoeffX = (sixAxisCalibrationBuf[19] << 8) | sixAxisCalibrationBuf[18];
-      gyroscopeCalibration.rawCoeffY = (sixAxisCalibrationBuf[21] << 8) | sixAxisCalibrationBuf[20];
-      gyroscopeCalibration.rawCoeffZ = (sixAxisCalibrationBuf[23] << 8) | sixAxisCalibrationBuf[22];
-
-      accelerometerCalibration.offsetX = (sixAxisParametersBuf[1] << 8) | sixAxisParametersBuf[0];
-      accelerometerCalibration.offsetY = (sixAxisParametersBuf[3] << 8) | sixAxisParametersBuf[2];
-      accelerometerCalibration.offsetZ = (sixAxisParametersBuf[5] << 8) | sixAxisParametersBuf[4];
-
-      accelerometerCalibration.coeffX = (1.0 / (accelerometerCalibration.rawCoeffX - accelerometerCalibration.originX)) * 4.0;
-      accelerometerCalibration.coeffY = (1.0 / (accelerometerCalibration.rawCoeffY - accelerometerCalibration.originY)) * 4.0;
-      accelerometerCalibration.coeffZ = (1.0 / (accelerometerCalibration.rawCoeffZ - accelerometerCalibration.originZ)) * 4.0;
-
-      gyroscopeCalibration.coeffX = 816.0 / (gyroscopeCalibration.rawCoeffX - gyroscopeCalibration.offsetX);
-      gyroscopeCalibration.coeffY = 816.0 / (gyroscopeCalibration.rawCoeffY - gyroscopeCalibration.offsetY);
-      gyroscopeCalibration.coeffZ = 816.0 / (gyroscopeCalibration.rawCoeffZ - gyroscopeCalibration.offsetZ);
+  if (sixAxisCalibrationBuf.size() >= 0x18) {
+    accelerometerCalibration.originX = calibrationInt16(sixAxisCalibrationBuf, 0);
+    accelerometerCalibration.originY = calibrationInt16(sixAxisCalibrationBuf, 2);
+    accelerometerCalibration.originZ = calibrationInt16(sixAxisCalibrationBuf, 4);
+    accelerometerCalibration.rawCoeffX = calibrationInt16(sixAxisCalibrationBuf, 6);
+    accelerometerCalibration.rawCoeffY = calibrationInt16(sixAxisCalibrationBuf, 8);
+    accelerometerCalibration.rawCoeffZ = calibrationInt16(sixAxisCalibrationBuf, 10);
+
+    gyroscopeCalibration.originX = calibrationInt16(sixAxisCalibrationBuf, 12);
+    gyroscopeCalibration.originY = calibrationInt16(sixAxisCalibrationBuf, 14);
+    gyroscopeCalibration.originZ = calibrationInt16(sixAxisCalibrationBuf, 16);
+    gyroscopeCalibration.rawCoeffX = calibrationInt16(sixAxisCalibrationBuf, 18);
+    gyroscopeCalibration.rawCoeffY = calibrationInt16(sixAxisCalibrationBuf, 20);
+    gyroscopeCalibration.rawCoeffZ = calibrationInt16(sixAxisCalibrationBuf, 22);
+
+    if (sixAxisParametersBuf.size() >= 6) {
+      accelerometerCalibration.offsetX = calibrationInt16(sixAxisParametersBuf, 0);
+      accelerometerCalibration.offsetY = calibrationInt16(sixAxisParametersBuf, 2);
+      accelerometerCalibration.offsetZ = calibrationInt16(sixAxisParametersBuf, 4);
     }
+
+    accelerometerCalibration.coeffX = (1.0 / (accelerometerCalibration.rawCoeffX - accelerometerCalibration.originX)) * 4.0;
+    accelerometerCalibration.coeffY = (1.0 / (accelerometerCalibration.rawCoeffY - accelerometerCalibration.originY)) * 4.0;
+    accelerometerCalibration.coeffZ = (1.0 / (accelerometerCalibration.rawCoeffZ - accelerometerCalibration.originZ)) * 4.0;
+
+    gyroscopeCalibration.coeffX = 816.0 / (gyroscopeCalibration.rawCoeffX - gyroscopeCalibration.offsetX);
+    gyroscopeCalibration.coeffY = 816.0 / (gyroscopeCalibration.rawCoeffY - gyroscopeCalibration.offsetY);
+    gyroscopeCalibration.coeffZ = 816.0 / (gyroscopeCalibration.rawCoeffZ - gyroscopeCalibration.offsetZ);
   }
 };
 
+bool Joytime::Controller::isUsable() const {
+  return usable;
+};
+
 void Joytime::Controller::performUsabilityCheck() {
   if (!usable) throw std::runtime_error("This Controller cannot be used (yet)");
 }
 
+// adapts a CompletionCallback to a SubcommandCallback for subcommands that only need acknowledging
+static Joytime::SubcommandCallback acknowledgement(Joytime::CompletionCallback callback) {
+  return [callback](Joytime::Controller* controller, const uint8_t* reply, size_t) {
+    if (callback) callback(controller, reply != nullptr);
+  };
+};
+
 void Joytime::Controller::setInputReportMode(Joytime::ControllerInputReportMode reportMode = Joytime::ControllerInputReportMode::StandardReport) {
   performUsabilityCheck();
-  std::vector<uint8_t> buf = { (uint8_t)(reportMode) };
+  uint8_t buf[] = { (uint8_t)(reportMode) };
+  uint8_t reply[Joytime::Transport::maxPacketSize];
 
-  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetInputReportMode, buf);
+  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetInputReportMode, buf, sizeof(buf), reply);
+};
+
+void Joytime::Controller::setInputReportModeAsync(Joytime::ControllerInputReportMode reportMode, Joytime::CompletionCallback callback) {
+  performUsabilityCheck();
+  uint8_t buf[] = { (uint8_t)(reportMode) };
+
+  sendSubcommandAsync(Joytime::ControllerSubcommand::SetInputReportMode, buf, sizeof(buf), acknowledgement(callback));
 };
 
 void Joytime::Controller::setSixAxisEnabled(bool sixAxis) {
   performUsabilityCheck();
-  std::vector<uint8_t> buf = { (uint8_t)((sixAxis) ? 1 : 0) };
+  uint8_t buf[] = { (uint8_t)((sixAxis) ? 1 : 0) };
+  uint8_t reply[Joytime::Transport::maxPacketSize];
+
+  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetSixAxisSensor, buf, sizeof(buf), reply);
+};
+
+void Joytime::Controller::setSixAxisEnabledAsync(bool sixAxis, Joytime::CompletionCallback callback) {
+  performUsabilityCheck();
+  uint8_t buf[] = { (uint8_t)((sixAxis) ? 1 : 0) };
 
-  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetSixAxisSensor, buf);
+  sendSubcommandAsync(Joytime::ControllerSubcommand::SetSixAxisSensor, buf, sizeof(buf), acknowledgement(callback));
 };
 
 void Joytime::Controller::setVibration(bool vibrate) {
   performUsabilityCheck();
-  std::vector<uint8_t> buf = { (uint8_t)((vibrate) ? 1 : 0) };
+  uint8_t buf[] = { (uint8_t)((vibrate) ? 1 : 0) };
+  uint8_t reply[Joytime::Transport::maxPacketSize];
+
+  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetVibration, buf, sizeof(buf), reply);
+};
+
+void Joytime::Controller::setVibrationAsync(bool vibrate, Joytime::CompletionCallback callback) {
+  performUsabilityCheck();
+  uint8_t buf[] = { (uint8_t)((vibrate) ? 1 : 0) };
 
-  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetVibration, buf);
+  sendSubcommandAsync(Joytime::ControllerSubcommand::SetVibration, buf, sizeof(buf), acknowledgement(callback));
 };
 
 void Joytime::Controller::rumble(uint8_t timing, Joytime::Rumble* _rumble) {
   performUsabilityCheck();
-  std::vector<uint8_t> buf = { timing };
 
-  std::vector<uint8_t> leftRumble = Joytime::neutralRumbleVector;
-  std::vector<uint8_t> rightRumble = Joytime::neutralRumbleVector;
+  Joytime::EncodedRumble leftRumble = Joytime::neutralRumbleEncoded;
+  Joytime::EncodedRumble rightRumble = Joytime::neutralRumbleEncoded;
 
   switch (type) {
     case Joytime::ControllerType::LeftJoycon:
-      leftRumble = _rumble->toVector();
+      leftRumble = _rumble->encoded();
       break;
     case Joytime::ControllerType::RightJoycon:
-      rightRumble = _rumble->toVector();
+      rightRumble = _rumble->encoded();
       break;
     case Joytime::ControllerType::Pro:
-      leftRumble = _rumble->toVector();
-      rightRumble = _rumble->toVector();
+      leftRumble = _rumble->encoded();
+      rightRumble = leftRumble;
       break;
   }
 
-  // 1-8
-  buf.insert(buf.begin() + 1, leftRumble.begin(), leftRumble.end());
-  buf.insert(buf.begin() + 5, rightRumble.begin(), rightRumble.end());
-
-  sendCommand(Joytime::ControllerCommand::SendRumble, buf);
+  queueRumble(timing, leftRumble.data(), rightRumble.data());
 };
 
 void Joytime::Controller::rumble(uint8_t timing, Joytime::Rumble* leftRumble, Joytime::Rumble* rightRumble) {
   performUsabilityCheck();
-  std::vector<uint8_t> buf = { timing };
 
+  Joytime::EncodedRumble leftFrame = leftRumble->encoded();
+  Joytime::EncodedRumble rightFrame = rightRumble->encoded();
+
+  queueRumble(timing, leftFrame.data(), rightFrame.data());
+};
+
+void Joytime::Controller::rumbleEncoded(uint8_t timing, const uint8_t* leftFrame, const uint8_t* rightFrame) {
+  performUsabilityCheck();
+  queueRumble(timing, leftFrame, rightFrame);
+};
+
+void Joytime::Controller::rumbleEncoded(uint8_t timing, const Joytime::EncodedRumble& leftFrame, const Joytime::EncodedRumble& rightFrame) {
+  rumbleEncoded(timing, leftFrame.data(), rightFrame.data());
+};
+
+void Joytime::Controller::transmitRumble(uint8_t timing, const uint8_t* frame) {
+  uint8_t buf[10] = { (uint8_t)Joytime::ControllerCommand::SendRumble, timing };
+
+  // 2-9
+  memcpy(buf + 2, frame, 8);
+
+  // rumble-only packets don't get a reply of their own; whatever
+  // comes in next is just the next input report
+  transmitBuffer_(buf, sizeof(buf));
+  counters.rumblesSent.fetch_add(1, std::memory_order_relaxed);
+};
+
+void Joytime::Controller::queueRumble(uint8_t timing, const uint8_t* left, const uint8_t* right) {
+  uint8_t frame[8];
+  memcpy(frame, left, 4);
+  memcpy(frame + 4, right, 4);
+
+  std::unique_lock<std::mutex> lock(rumbleMutex);
 
-  std::vector<uint8_t> leftRumbleVector = leftRumble->toVector();
-  std::vector<uint8_t> rightRumbleVector = rightRumble->toVector();
+  if (rumbleSent && memcmp(frame, sentRumble, sizeof(frame)) == 0) {
+    // same as what the controller is already doing. drop anything coalesced in the meantime
+    counters.rumblesSkipped.fetch_add(rumblePending ? 2 : 1, std::memory_order_relaxed);
+    rumblePending = false;
+    return;
+  }
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (rumbleSent && now - rumbleSentAt < std::chrono::milliseconds(rumbleInterval)) {
+    if (rumblePending) counters.rumblesSkipped.fetch_add(1, std::memory_order_relaxed);
+    memcpy(pendingRumble, frame, sizeof(frame));
+    pendingRumbleTiming = timing;
+    rumblePending = true;
+    return;
+  }
 
-  // 1-8
-  buf.insert(buf.begin() + 1, leftRumbleVector.begin(), leftRumbleVector.end());
-  buf.insert(buf.begin() + 5, rightRumbleVector.begin(), rightRumbleVector.end());
+  memcpy(sentRumble, frame, sizeof(frame));
+  rumbleSent = true;
+  rumblePending = false;
+  rumbleSentAt = now;
+  lock.unlock();
 
-  sendCommand(Joytime::ControllerCommand::SendRumble, buf);
+  transmitRumble(timing, frame);
+};
+
+void Joytime::Controller::flushRumble() {
+  std::unique_lock<std::mutex> lock(rumbleMutex);
+  if (!rumbleSent) return;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  uint8_t frame[8];
+  uint8_t timing;
+
+  if (rumblePending) {
+    if (now - rumbleSentAt < std::chrono::milliseconds(rumbleInterval)) return;
+
+    memcpy(sentRumble, pendingRumble, sizeof(sentRumble));
+    rumblePending = false;
+    timing = pendingRumbleTiming;
+  } else {
+    if (rumbleKeepAlive <= 0 || now - rumbleSentAt < std::chrono::milliseconds(rumbleKeepAlive)) return;
+    // nothing to keep alive once the motors are idle
+    if (memcmp(sentRumble, Joytime::neutralRumbleEncoded.data(), 4) == 0 && memcmp(sentRumble + 4, Joytime::neutralRumbleEncoded.data(), 4) == 0) return;
+
+    timing = nextPacketCounter();
+  }
+
+  memcpy(frame, sentRumble, sizeof(frame));
+  rumbleSentAt = now;
+  lock.unlock();
+
+  transmitRumble(timing, frame);
 };
 
 uint8_t ledStateToFlag(Joytime::ControllerLEDState led, uint8_t position) {
@@ -334,101 +688,519 @@ void Joytime::Controller::setLEDs(Joytime::ControllerLEDState led1, Joytime::Con
   flag |= ledStateToFlag(led3, 3);
   flag |= ledStateToFlag(led4, 4);
 
-  std::vector<uint8_t> buf = { flag };
+  uint8_t buf[] = { flag };
+  uint8_t reply[Joytime::Transport::maxPacketSize];
+
+  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetPlayerLights, buf, sizeof(buf), reply);
+};
+
+void Joytime::Controller::setLEDsAsync(Joytime::ControllerLEDState led1, Joytime::ControllerLEDState led2, Joytime::ControllerLEDState led3, Joytime::ControllerLEDState led4, Joytime::CompletionCallback callback) {
+  performUsabilityCheck();
+  uint8_t flag = 0;
+
+  flag |= ledStateToFlag(led1, 1);
+  flag |= ledStateToFlag(led2, 2);
+  flag |= ledStateToFlag(led3, 3);
+  flag |= ledStateToFlag(led4, 4);
+
+  uint8_t buf[] = { flag };
 
-  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetPlayerLights, buf);
+  sendSubcommandAsync(Joytime::ControllerSubcommand::SetPlayerLights, buf, sizeof(buf), acknowledgement(callback));
 };
 
 void Joytime::Controller::setPowerState(Joytime::ControllerPowerState state) {
   performUsabilityCheck();
-  std::vector<uint8_t> buf = { (uint8_t)state };
+  uint8_t buf[] = { (uint8_t)state };
+  uint8_t reply[Joytime::Transport::maxPacketSize];
+
+  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetPowerState, buf, sizeof(buf), reply);
+};
+
+void Joytime::Controller::setPowerStateAsync(Joytime::ControllerPowerState state, Joytime::CompletionCallback callback) {
+  performUsabilityCheck();
+  uint8_t buf[] = { (uint8_t)state };
+
+  sendSubcommandAsync(Joytime::ControllerSubcommand::SetPowerState, buf, sizeof(buf), acknowledgement(callback));
+};
+
+void Joytime::Controller::setMCUState(Joytime::MCUState state) {
+  performUsabilityCheck();
+  uint8_t buf[] = { (uint8_t)state };
+  uint8_t reply[Joytime::Transport::maxPacketSize];
 
-  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetPowerState, buf);
+  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetMCUState, buf, sizeof(buf), reply);
+};
+
+void Joytime::Controller::setMCUStateAsync(Joytime::MCUState state, Joytime::CompletionCallback callback) {
+  performUsabilityCheck();
+  uint8_t buf[] = { (uint8_t)state };
+
+  sendSubcommandAsync(Joytime::ControllerSubcommand::SetMCUState, buf, sizeof(buf), acknowledgement(callback));
+};
+
+// MCU configuration arguments: the command, 36 bytes of arguments, then a checksum of those 36 bytes
+static const size_t mcuConfigurationSize = 38;
+static const size_t mcuArgumentsSize = 36;
+
+static void buildMCUConfiguration(uint8_t* buf, Joytime::MCUConfigurationCommand command, const uint8_t* arguments, size_t size) {
+  if (size > mcuArgumentsSize) throw std::runtime_error("Could not configure the MCU: too many arguments.");
+
+  memset(buf, 0, mcuConfigurationSize);
+  buf[0] = (uint8_t)command;
+  if (size > 0) memcpy(buf + 1, arguments, size);
+  buf[mcuConfigurationSize - 1] = Joytime::mcuCRC8(buf + 1, mcuArgumentsSize);
+};
+
+void Joytime::Controller::setMCUConfiguration(Joytime::MCUConfigurationCommand command, const uint8_t* arguments, size_t size) {
+  performUsabilityCheck();
+  uint8_t buf[mcuConfigurationSize];
+  uint8_t reply[Joytime::Transport::maxPacketSize];
+
+  buildMCUConfiguration(buf, command, arguments, size);
+  sendSubcommand(Joytime::ControllerCommand::RumbleAndSubcommand, Joytime::ControllerSubcommand::SetMCUConfiguration, buf, sizeof(buf), reply);
+};
+
+void Joytime::Controller::setMCUConfigurationAsync(Joytime::MCUConfigurationCommand command, const uint8_t* arguments, size_t size, Joytime::CompletionCallback callback) {
+  performUsabilityCheck();
+  uint8_t buf[mcuConfigurationSize];
+
+  buildMCUConfiguration(buf, command, arguments, size);
+  sendSubcommandAsync(Joytime::ControllerSubcommand::SetMCUConfiguration, buf, sizeof(buf), acknowledgement(callback));
+};
+
+void Joytime::Controller::setMCUMode(Joytime::MCUMode mode) {
+  uint8_t buf[] = { 0x00, (uint8_t)mode };
+  setMCUConfiguration(Joytime::MCUConfigurationCommand::SetMode, buf, sizeof(buf));
+};
+
+void Joytime::Controller::setMCUModeAsync(Joytime::MCUMode mode, Joytime::CompletionCallback callback) {
+  uint8_t buf[] = { 0x00, (uint8_t)mode };
+  setMCUConfigurationAsync(Joytime::MCUConfigurationCommand::SetMode, buf, sizeof(buf), callback);
+};
+
+void Joytime::Controller::sendMCURequest(Joytime::MCURequest request, const uint8_t* arguments, size_t size) {
+  performUsabilityCheck();
+  if (size > mcuArgumentsSize) throw std::runtime_error("Could not send MCU request: too many arguments.");
+
+  // command, counter, rumble, request, arguments, checksum
+  uint8_t buf[11 + mcuArgumentsSize + 1] = { 0 };
+
+  buf[0] = (uint8_t)Joytime::ControllerCommand::MCURequest;
+  buf[1] = nextPacketCounter();
+
+  memcpy(buf + 2, Joytime::neutralRumbleEncoded.data(), 4);
+  memcpy(buf + 6, Joytime::neutralRumbleEncoded.data(), 4);
+
+  buf[10] = (uint8_t)request;
+  if (size > 0) memcpy(buf + 11, arguments, size);
+  buf[11 + mcuArgumentsSize] = Joytime::mcuCRC8(buf + 11, mcuArgumentsSize);
+
+  transmitBuffer_(buf, sizeof(buf));
+};
+
+unsigned int Joytime::Controller::addMCUListener(Joytime::MCUListener listener) {
+  std::lock_guard<std::mutex> lock(mcuListenerMutex);
+
+  std::shared_ptr<MCUListenerList> listeners = mcuListeners ? std::make_shared<MCUListenerList>(*mcuListeners) : std::make_shared<MCUListenerList>();
+  unsigned int id = ++mcuListenerCounter;
+  listeners->emplace_back(id, std::move(listener));
+  mcuListeners = listeners;
+
+  return id;
+};
+
+void Joytime::Controller::removeMCUListener(unsigned int id) {
+  std::lock_guard<std::mutex> lock(mcuListenerMutex);
+  if (!mcuListeners) return;
+
+  std::shared_ptr<MCUListenerList> listeners = std::make_shared<MCUListenerList>(*mcuListeners);
+  listeners->erase(std::remove_if(listeners->begin(), listeners->end(), [id](const std::pair<unsigned int, Joytime::MCUListener>& entry) {
+    return entry.first == id;
+  }), listeners->end());
+  mcuListeners = listeners;
+};
+
+// where the MCU section starts in an NFC/IR report
+static const size_t mcuReportOffset = 49;
+
+void Joytime::Controller::dispatchMCUReport(const uint8_t* buf, size_t size) {
+  if (buf[0] != (uint8_t)Joytime::ControllerReportCode::NFCIR || size <= mcuReportOffset) return;
+
+  std::shared_ptr<const MCUListenerList> listeners;
+  {
+    std::lock_guard<std::mutex> lock(mcuListenerMutex);
+    listeners = mcuListeners;
+  }
+  if (!listeners || listeners->empty()) return;
+
+  Joytime::MCUReportView report;
+  report.code = (Joytime::MCUReportCode)buf[mcuReportOffset];
+  report.data = buf + mcuReportOffset;
+  report.size = size - mcuReportOffset;
+
+  for (const std::pair<unsigned int, Joytime::MCUListener>& entry: *listeners) {
+    entry.second(this, report);
+  }
 };
 
 void Joytime::Controller::update() {
   performUsabilityCheck();
-  std::vector<uint8_t> buf = sendCommand(Joytime::ControllerCommand::RumbleAndSubcommand, std::vector<uint8_t>());
-  return update(buf);
+  uint8_t buf[Joytime::Transport::maxPacketSize];
+  // the reply is decoded by sendCommand
+  sendCommand(Joytime::ControllerCommand::RumbleAndSubcommand, nullptr, 0, buf);
+  flushRumble();
 };
 
-void Joytime::Controller::update(std::vector<uint8_t> buf) {
+void Joytime::Controller::enableReportQueue(size_t capacity, Joytime::ReportQueueOverflowPolicy policy) {
+  reportQueue.reset(new Joytime::ReportQueue(capacity, policy));
+};
+
+size_t Joytime::Controller::receiveReports(int timeout) {
   performUsabilityCheck();
-  if (buf.size() < 1) return;
+  if (!reportQueue) throw std::runtime_error("The report queue is not enabled for this Controller");
+  if (!transport) throw std::runtime_error("Could not receive reports: no receive function is set.");
 
-  switch (buf[0]) {
-    case (uint8_t)Joytime::ControllerReportCode::StandardOSController:
-      break;
-    case (uint8_t)Joytime::ControllerReportCode::NFCIR:
-      // no break; the packet also contains a standard input report
+  std::lock_guard<std::mutex> receiveLock(receiveMutex);
+  return reportQueue->receiveFrom(transport.get(), timeout, Joytime::ReportQueue::maxBatchSize, &Joytime::Controller::routeReport, this);
+};
+
+size_t Joytime::Controller::processReports(size_t maxReports) {
+  performUsabilityCheck();
+  if (!reportQueue) throw std::runtime_error("The report queue is not enabled for this Controller");
+
+  uint8_t buf[Joytime::Transport::maxPacketSize];
+  size_t processed = 0;
+  size_t size;
+
+  while (processed < maxReports && (size = reportQueue->pop(buf)) > 0) {
+    update(buf, size);
+    processed++;
+  }
+
+  flushRumble();
+
+  return processed;
+};
+
+Joytime::ReportQueueStatistics Joytime::Controller::reportQueueStatistics() const {
+  if (!reportQueue) return Joytime::ReportQueueStatistics();
+  return reportQueue->statistics();
+};
+
+size_t Joytime::Controller::poll(int timeout) {
+  performUsabilityCheck();
+
+  if (reportQueue) {
+    // the transport thread does the reading (and routes replies); just decode
+    checkSubcommandTimeout();
+    return processReports();
+  }
+
+  flushRumble();
+
+  std::unique_lock<std::mutex> receiveLock(receiveMutex, std::try_to_lock);
+  if (!receiveLock.owns_lock()) return 0;
+  if (!transport) throw std::runtime_error("Could not receive reports: no receive function is set.");
+
+  uint8_t bufs[Joytime::ReportQueue::maxBatchSize][Joytime::Transport::maxPacketSize];
+  Joytime::PacketView views[Joytime::ReportQueue::maxBatchSize];
+  for (size_t i = 0; i < Joytime::ReportQueue::maxBatchSize; i++) {
+    views[i].data = bufs[i];
+    views[i].size = sizeof(bufs[i]);
+  }
+
+  size_t received = transport->receiveBatch(views, Joytime::ReportQueue::maxBatchSize, timeout);
+  receiveLock.unlock();
+
+  for (size_t i = 0; i < received; i++) {
+    routeReport(views[i].data, views[i].size);
+    update(views[i].data, views[i].size);
+  }
+
+  checkSubcommandTimeout();
+
+  return received;
+};
+
+Joytime::ControllerState Joytime::Controller::snapshot() const {
+  Joytime::ControllerState state;
+
+  while (true) {
+    uint32_t version = stateVersion.load(std::memory_order_acquire);
+    if (version & 1) continue;
+
+    state = publishedState;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (stateVersion.load(std::memory_order_relaxed) == version) break;
+  }
+
+  return state;
+};
+
+// what a report with the given code needs to be fully decoded
+static size_t minimumReportSize(uint8_t code) {
+  switch (code) {
     case (uint8_t)Joytime::ControllerReportCode::SubcommandReply:
-      // no break; the packet also (partially) contains a standard input report
+      return Joytime::detail::inputReportSize;
     case (uint8_t)Joytime::ControllerReportCode::Standard:
-      uint8_t _battery = (buf[2] & 0xf0) >> 4;
-      if (_battery & 0x01) {
-        battery = Joytime::ControllerBatteryStatus::Charging;
-      } else {
-        battery = (Joytime::ControllerBatteryStatus)_battery;
-      }
+    case (uint8_t)Joytime::ControllerReportCode::NFCIR:
+      return Joytime::detail::standardReportSize;
+    case (uint8_t)Joytime::ControllerReportCode::StandardOSController:
+      return 4;
+    default:
+      return 0;
+  }
+};
 
-      buttons.a = buf[3] & 0x08;
-      buttons.b = buf[3] & 0x04;
-      buttons.x = buf[3] & 0x02;
-      buttons.y = buf[3] & 0x01;
+void Joytime::Controller::storeSixAxisSamples(const uint8_t* buf, size_t size) {
+  if (size < Joytime::detail::standardReportSize) return;
+  if (buf[0] != (uint8_t)Joytime::ControllerReportCode::Standard && buf[0] != (uint8_t)Joytime::ControllerReportCode::NFCIR) return;
 
-      buttons.up = buf[5] & 0x02;
-      buttons.down = buf[5] & 0x01;
-      buttons.left = buf[5] & 0x08;
-      buttons.right = buf[5] & 0x04;
+  std::lock_guard<std::mutex> lock(sixAxisMutex);
 
-      buttons.l = buf[5] & 0x40;
-      buttons.r = buf[3] & 0x40;
+  for (size_t i = 0; i < Joytime::detail::sixAxisSampleCount; i++) {
+    if (sixAxisCount == sixAxisBufferSize) {
+      // full; the oldest one goes
+      sixAxisStart = (sixAxisStart + 1) % sixAxisBufferSize;
+      sixAxisCount--;
+      counters.sixAxisSamplesDropped.fetch_add(1, std::memory_order_relaxed);
+    }
 
-      buttons.zl = buf[5] & 0x80;
-      buttons.zr = buf[3] & 0x80;
+    Joytime::SixAxisSample& sample = sixAxisSamples[(sixAxisStart + sixAxisCount) % sixAxisBufferSize];
+    sample.timer = buf[1];
+    sample.index = i;
+    Joytime::detail::decodeSixAxisSample(buf + Joytime::detail::sixAxisSampleOffset + i * Joytime::detail::sixAxisSampleSize, *this, sample.accelerometer, sample.gyroscope);
+    sixAxisCount++;
+  }
+};
 
-      buttons.sl = (buf[5] & 0x20) | (buf[3] & 0x20);
-      buttons.sr = (buf[5] & 0x10) | (buf[3] & 0x10);
+size_t Joytime::Controller::readSixAxisSamples(Joytime::SixAxisSample* samples, size_t capacity) {
+  std::lock_guard<std::mutex> lock(sixAxisMutex);
 
-      buttons.plus = buf[4] & 0x02;
-      buttons.minus = buf[4] & 0x01;
+  size_t count = std::min(capacity, sixAxisCount);
+  for (size_t i = 0; i < count; i++) {
+    samples[i] = sixAxisSamples[(sixAxisStart + i) % sixAxisBufferSize];
+  }
 
-      buttons.lStick = buf[4] & 0x08;
-      buttons.rStick = buf[4] & 0x04;
+  sixAxisStart = (sixAxisStart + count) % sixAxisBufferSize;
+  sixAxisCount -= count;
 
-      buttons.home = buf[4] & 0x10;
-      buttons.capture = buf[4] & 0x20;
+  return count;
+};
 
-      int16_t rawLeftX = (((buf[7] & 0xf) << 8) | buf[6]);
-      int16_t rawLeftY = ((buf[8] << 4) | (buf[7] >> 4));
-      int16_t rawRightX = (((buf[10] & 0xf) << 8) | buf[9]);
-      int16_t rawRightY = ((buf[11] << 4) | (buf[10] >> 4));
+Joytime::ControllerStatistics Joytime::Controller::statistics() const {
+  Joytime::ControllerStatistics statistics;
 
-      leftStick.x = rawLeftX - leftStickCalibration.xCenter;
-      leftStick.y = rawLeftY - leftStickCalibration.yCenter;
+  statistics.reports = counters.reports.load(std::memory_order_relaxed);
+  statistics.truncatedReports = counters.truncatedReports.load(std::memory_order_relaxed);
+  statistics.subcommandsSent = counters.subcommandsSent.load(std::memory_order_relaxed);
+  statistics.subcommandsFailed = counters.subcommandsFailed.load(std::memory_order_relaxed);
+  statistics.rumblesSent = counters.rumblesSent.load(std::memory_order_relaxed);
+  statistics.rumblesSkipped = counters.rumblesSkipped.load(std::memory_order_relaxed);
+  statistics.sixAxisSamplesDropped = counters.sixAxisSamplesDropped.load(std::memory_order_relaxed);
 
-      rightStick.x = rawRightX - rightStickCalibration.xCenter;
-      rightStick.y = rawRightY - rightStickCalibration.yCenter;
+  return statistics;
+};
 
-      if (buf[0] != (uint8_t)Joytime::ControllerReportCode::SubcommandReply) {
-        int16_t rawAccelX = (buf[14] << 8) | buf[13];
-        int16_t rawAccelY = (buf[16] << 8) | buf[15];
-        int16_t rawAccelZ = (buf[18] << 8) | buf[17];
-        int16_t rawGyroX = (buf[20] << 8) | buf[19];
-        int16_t rawGyroY = (buf[22] << 8) | buf[21];
-        int16_t rawGyroZ = (buf[24] << 8) | buf[23];
+void Joytime::Controller::update(const uint8_t* buf, size_t size) {
+  performUsabilityCheck();
+  if (size < 1) return;
+
+  bool switchMode = false;
+  Joytime::ControllerInputReportMode mode;
+
+  {
+    // only one thread decodes at a time; readers use the seqlock in `snapshot`
+    std::lock_guard<std::mutex> lock(decodeMutex);
+
+    Joytime::ControllerState state = publishedState;
+    decodeReport(buf, size, state);
+    state.sequence++;
+
+    counters.reports.fetch_add(1, std::memory_order_relaxed);
+    if (size < minimumReportSize(buf[0])) counters.truncatedReports.fetch_add(1, std::memory_order_relaxed);
+    storeSixAxisSamples(buf, size);
+
+    switchMode = checkLowPower(buf, publishedState, state, mode);
+
+    uint32_t version = stateVersion.load(std::memory_order_relaxed);
+    stateVersion.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    publishedState = state;
+    stateVersion.store(version + 2, std::memory_order_release);
+
+    timer = state.timer;
+    battery = state.battery;
+    buttons = state.buttons;
+    leftStick = state.leftStick;
+    rightStick = state.rightStick;
+    accelerometer = state.accelerometer;
+    gyroscope = state.gyroscope;
+  }
 
-        accelerometer.x = (rawAccelX - accelerometerCalibration.offsetX) * accelerometerCalibration.coeffX;
-        accelerometer.y = (rawAccelY - accelerometerCalibration.offsetY) * accelerometerCalibration.coeffY;
-        accelerometer.z = (rawAccelZ - accelerometerCalibration.offsetZ) * accelerometerCalibration.coeffZ;
+  if (switchMode) {
+    setInputReportModeAsync(mode, [](Joytime::Controller* controller, bool) {
+      controller->reportModeSwitchPending = false;
+    });
+  }
 
-        gyroscope.x = rawGyroX * gyroscopeCalibration.coeffX;
-        gyroscope.y = rawGyroY * gyroscopeCalibration.coeffY;
-        gyroscope.z = rawGyroZ * gyroscopeCalibration.coeffZ;
-      }
+  dispatchMCUReport(buf, size);
+  updated.emit(this);
+};
+
+static bool anyButtonPressed(const Joytime::Buttons& buttons) {
+  return buttons.a || buttons.b || buttons.x || buttons.y ||
+    buttons.up || buttons.down || buttons.left || buttons.right ||
+    buttons.l || buttons.r || buttons.zl || buttons.zr || buttons.sl || buttons.sr ||
+    buttons.plus || buttons.minus || buttons.lStick || buttons.rStick || buttons.home || buttons.capture;
+};
+
+static bool stickMoved(const Joytime::Stick& stick) {
+  return std::abs(stick.x) > Joytime::Controller::lowPowerStickThreshold || std::abs(stick.y) > Joytime::Controller::lowPowerStickThreshold;
+};
+
+// without calibration the center is 0, so raw values would always look pushed. go by
+// how far the stick moved since the last report instead; that's only meaningful if
+// both reports were of the same kind, since SimpleHID sticks use other units
+static bool stickActive(const Joytime::Stick& previous, const Joytime::Stick& stick, const Joytime::StickCalibrationData& calibration, bool comparable) {
+  if (calibration.xCenter != 0 || calibration.yCenter != 0) return stickMoved(stick);
+  if (!comparable) return false;
+
+  Joytime::Stick delta;
+  delta.x = stick.x - previous.x;
+  delta.y = stick.y - previous.y;
+  return stickMoved(delta);
+};
+
+void Joytime::Controller::enableLowPowerMode(int idleTimeout) {
+  std::lock_guard<std::mutex> lock(decodeMutex);
+  lowPowerIdleTimeout = idleTimeout;
+  lastActivity = std::chrono::steady_clock::now();
+};
+
+void Joytime::Controller::disableLowPowerMode() {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(decodeMutex);
+    lowPowerIdleTimeout = 0;
+    wake = lastReportCode == (uint8_t)Joytime::ControllerReportCode::StandardOSController;
+  }
+
+  if (wake) setInputReportMode(Joytime::ControllerInputReportMode::StandardReport);
+};
+
+bool Joytime::Controller::checkLowPower(const uint8_t* buf, const Joytime::ControllerState& previous, const Joytime::ControllerState& state, Joytime::ControllerInputReportMode& mode) {
+  // subcommand replies don't say anything about the current report mode
+  if (buf[0] == (uint8_t)Joytime::ControllerReportCode::SubcommandReply) return false;
+  bool comparable = lastReportCode == buf[0];
+  lastReportCode = buf[0];
+
+  if (lowPowerIdleTimeout <= 0) return false;
+
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  bool active = anyButtonPressed(state.buttons) ||
+    stickActive(previous.leftStick, state.leftStick, leftStickCalibration, comparable) ||
+    stickActive(previous.rightStick, state.rightStick, rightStickCalibration, comparable) ||
+    anyButtonPressed(previous.buttons) != anyButtonPressed(state.buttons);
+  if (active) lastActivity = now;
+
+  if (reportModeSwitchPending) return false;
+
+  if (buf[0] == (uint8_t)Joytime::ControllerReportCode::StandardOSController && active) {
+    mode = Joytime::ControllerInputReportMode::StandardReport;
+  } else if (buf[0] == (uint8_t)Joytime::ControllerReportCode::Standard && now - lastActivity >= std::chrono::milliseconds(lowPowerIdleTimeout)) {
+    mode = Joytime::ControllerInputReportMode::SimpleHID;
+  } else {
+    return false;
+  }
+
+  reportModeSwitchPending = true;
+  return true;
+};
+
+// SimpleHID hat directions, clockwise from up. 8 is neutral
+static const int8_t hatX[] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int8_t hatY[] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+// how far a JoyCon's stick is reported to be pushed when its hat is
+static const int16_t hatStickMagnitude = 1400;
 
+void Joytime::Controller::decodeSimpleHIDReport(const uint8_t* buf, size_t size, Joytime::ControllerState& state) {
+  if (size < 4) return;
+
+  uint8_t hat = buf[3];
+  bool hatPressed = hat < 8;
+
+  state.buttons.minus = buf[2] & 0x01;
+  state.buttons.plus = buf[2] & 0x02;
+  state.buttons.lStick = buf[2] & 0x04;
+  state.buttons.rStick = buf[2] & 0x08;
+  state.buttons.home = buf[2] & 0x10;
+  state.buttons.capture = buf[2] & 0x20;
+
+  switch (type) {
+    case Joytime::ControllerType::LeftJoycon:
+      state.buttons.down = buf[1] & 0x01;
+      state.buttons.right = buf[1] & 0x02;
+      state.buttons.left = buf[1] & 0x04;
+      state.buttons.up = buf[1] & 0x08;
+      state.buttons.sl = buf[1] & 0x10;
+      state.buttons.sr = buf[1] & 0x20;
+      state.buttons.l = buf[2] & 0x40;
+      state.buttons.zl = buf[2] & 0x80;
+
+      // the stick is only reported as a hat, relative to the JoyCon held sideways
+      state.leftStick.x = hatPressed ? -hatY[hat] * hatStickMagnitude : 0;
+      state.leftStick.y = hatPressed ? hatX[hat] * hatStickMagnitude : 0;
+      break;
+    case Joytime::ControllerType::RightJoycon:
+      state.buttons.a = buf[1] & 0x01;
+      state.buttons.x = buf[1] & 0x02;
+      state.buttons.b = buf[1] & 0x04;
+      state.buttons.y = buf[1] & 0x08;
+      state.buttons.sl = buf[1] & 0x10;
+      state.buttons.sr = buf[1] & 0x20;
+      state.buttons.r = buf[2] & 0x40;
+      state.buttons.zr = buf[2] & 0x80;
+
+      state.rightStick.x = hatPressed ? hatY[hat] * hatStickMagnitude : 0;
+      state.rightStick.y = hatPressed ? -hatX[hat] * hatStickMagnitude : 0;
+      break;
+    case Joytime::ControllerType::Pro:
+      state.buttons.b = buf[1] & 0x01;
+      state.buttons.a = buf[1] & 0x02;
+      state.buttons.y = buf[1] & 0x04;
+      state.buttons.x = buf[1] & 0x08;
+      state.buttons.l = buf[1] & 0x10;
+      state.buttons.r = buf[1] & 0x20;
+      state.buttons.zl = buf[1] & 0x40;
+      state.buttons.zr = buf[1] & 0x80;
+
+      // the D-pad is the hat
+      state.buttons.up = hatPressed && hatY[hat] > 0;
+      state.buttons.down = hatPressed && hatY[hat] < 0;
+      state.buttons.right = hatPressed && hatX[hat] > 0;
+      state.buttons.left = hatPressed && hatX[hat] < 0;
+
+      // 16-bit little endian values with 8 bits of actual resolution, Y pointing down.
+      // scaled to the 12-bit range of standard reports
+      if (size >= 12) {
+        state.leftStick.x = (buf[5] - 0x80) * 16;
+        state.leftStick.y = (0x80 - buf[7]) * 16;
+        state.rightStick.x = (buf[9] - 0x80) * 16;
+        state.rightStick.y = (0x80 - buf[11]) * 16;
+      }
       break;
   }
+};
 
-  updated.emit(this);
+void Joytime::Controller::decodeReport(const uint8_t* buf, size_t size, Joytime::ControllerState& state) {
+  if (buf[0] == (uint8_t)Joytime::ControllerReportCode::StandardOSController) {
+    // no timer or battery in these
+    decodeSimpleHIDReport(buf, size, state);
+    return;
+  }
+
+  // controllers of any type are decoded as if they had everything, like a Pro Controller
+  Joytime::detail::decodeInputReport<Joytime::ControllerType::Pro>(buf, size, *this, state);
 };
@@ -0,0 +1,110 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+Joytime::FleetInitializer::FleetInitializer(size_t workerCount, bool _calibrate, bool attach):
+  calibrate(_calibrate) {
+  workerCount = std::max(workerCount, (size_t)1);
+  for (size_t i = 0; i < workerCount; i++) {
+    workers.emplace_back(&Joytime::FleetInitializer::work, this);
+  }
+
+  if (attach) {
+    attached = true;
+    availableHandler = Joytime::controllerAvailable().on([this](Joytime::Controller* controller) {
+      add(controller);
+    });
+    removedHandler = Joytime::controllerRemoved().on([this](Joytime::Controller* controller) {
+      remove(controller);
+    });
+  }
+};
+
+Joytime::FleetInitializer::~FleetInitializer() {
+  if (attached) {
+    Joytime::controllerAvailable().removeHandler(availableHandler);
+    Joytime::controllerRemoved().removeHandler(removedHandler);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    pending.clear();
+  }
+  wake.notify_all();
+
+  for (std::thread& worker: workers) worker.join();
+};
+
+void Joytime::FleetInitializer::add(Joytime::Controller* controller) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) return;
+    if (std::find(pending.begin(), pending.end(), controller) != pending.end()) return;
+    pending.push_back(controller);
+  }
+  wake.notify_one();
+};
+
+void Joytime::FleetInitializer::remove(Joytime::Controller* controller) {
+  std::unique_lock<std::mutex> lock(mutex);
+  pending.erase(std::remove(pending.begin(), pending.end(), controller), pending.end());
+  if (pending.empty() && active == 0) idle.notify_all();
+
+  // a listener on the worker that's announcing this controller can't wait for itself
+  std::thread::id self = std::this_thread::get_id();
+  finished.wait(lock, [this, controller, self] {
+    return std::none_of(initializing.begin(), initializing.end(), [controller, self](const std::pair<Joytime::Controller*, std::thread::id>& entry) {
+      return entry.first == controller && entry.second != self;
+    });
+  });
+};
+
+void Joytime::FleetInitializer::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] {
+    return pending.empty() && active == 0;
+  });
+};
+
+void Joytime::FleetInitializer::work() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    wake.wait(lock, [this] {
+      return stopping || !pending.empty();
+    });
+    if (stopping) return;
+
+    Joytime::Controller* controller = pending.front();
+    pending.pop_front();
+    active++;
+    initializing.emplace_back(controller, std::this_thread::get_id());
+    int timeout = subcommandTimeout;
+
+    lock.unlock();
+
+    // `timeout` keeps a controller that never replies from holding up this worker forever
+    bool success = true;
+    try {
+      controller->initialize(calibrate, timeout);
+    } catch (const std::exception&) {
+      success = false;
+    }
+
+    // still counts as being initialized until the listeners are done with it
+    if (success) {
+      ready.emit(controller);
+    } else {
+      failed.emit(controller);
+    }
+
+    lock.lock();
+    initializing.erase(std::find(initializing.begin(), initializing.end(), std::make_pair(controller, std::this_thread::get_id())));
+    finished.notify_all();
+    active--;
+    if (pending.empty() && active == 0) idle.notify_all();
+  }
+};
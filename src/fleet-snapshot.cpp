@@ -0,0 +1,110 @@
+#include "joytime-core.hpp"
+#include <cstdint>
+#include <vector>
+
+uint32_t Joytime::packButtons(const Joytime::Buttons& buttons) {
+  return
+    ((uint32_t)buttons.a << 0) |
+    ((uint32_t)buttons.b << 1) |
+    ((uint32_t)buttons.x << 2) |
+    ((uint32_t)buttons.y << 3) |
+    ((uint32_t)buttons.up << 4) |
+    ((uint32_t)buttons.down << 5) |
+    ((uint32_t)buttons.left << 6) |
+    ((uint32_t)buttons.right << 7) |
+    ((uint32_t)buttons.l << 8) |
+    ((uint32_t)buttons.r << 9) |
+    ((uint32_t)buttons.zl << 10) |
+    ((uint32_t)buttons.zr << 11) |
+    ((uint32_t)buttons.sl << 12) |
+    ((uint32_t)buttons.sr << 13) |
+    ((uint32_t)buttons.plus << 14) |
+    ((uint32_t)buttons.minus << 15) |
+    ((uint32_t)buttons.lStick << 16) |
+    ((uint32_t)buttons.rStick << 17) |
+    ((uint32_t)buttons.home << 18) |
+    ((uint32_t)buttons.capture << 19);
+};
+
+Joytime::Buttons Joytime::unpackButtons(uint32_t mask) {
+  Joytime::Buttons buttons;
+
+  buttons.a = mask & (1 << 0);
+  buttons.b = mask & (1 << 1);
+  buttons.x = mask & (1 << 2);
+  buttons.y = mask & (1 << 3);
+  buttons.up = mask & (1 << 4);
+  buttons.down = mask & (1 << 5);
+  buttons.left = mask & (1 << 6);
+  buttons.right = mask & (1 << 7);
+  buttons.l = mask & (1 << 8);
+  buttons.r = mask & (1 << 9);
+  buttons.zl = mask & (1 << 10);
+  buttons.zr = mask & (1 << 11);
+  buttons.sl = mask & (1 << 12);
+  buttons.sr = mask & (1 << 13);
+  buttons.plus = mask & (1 << 14);
+  buttons.minus = mask & (1 << 15);
+  buttons.lStick = mask & (1 << 16);
+  buttons.rStick = mask & (1 << 17);
+  buttons.home = mask & (1 << 18);
+  buttons.capture = mask & (1 << 19);
+
+  return buttons;
+};
+
+size_t Joytime::FleetSnapshot::write(Joytime::Controller* const* controllers, size_t count, Joytime::FleetSnapshotColumns& columns, bool changesOnly) {
+  // sequences start at 0 before the first report, so a fresh entry
+  // is one that can't match any real sequence
+  if (capturedSequences.size() < count) capturedSequences.resize(count, UINT64_MAX);
+
+  // changes pick up where the last call stopped, so with a full buffer every call,
+  // the controllers past the first `capacity` still get their turn
+  size_t start = (changesOnly && nextIndex < count) ? nextIndex : 0;
+  size_t row = 0;
+  size_t visited = 0;
+
+  for (; visited < count && row < columns.capacity; visited++) {
+    size_t i = (start + visited) % count;
+    if (controllers[i] == nullptr) continue;
+
+    Joytime::ControllerState state = controllers[i]->snapshot();
+    if (changesOnly && state.sequence == capturedSequences[i]) continue;
+    capturedSequences[i] = state.sequence;
+
+    if (columns.index) columns.index[row] = (uint32_t)i;
+    if (columns.sequence) columns.sequence[row] = state.sequence;
+    if (columns.timer) columns.timer[row] = state.timer;
+    if (columns.battery) columns.battery[row] = state.battery;
+    if (columns.buttons) columns.buttons[row] = Joytime::packButtons(state.buttons);
+    if (columns.leftStickX) columns.leftStickX[row] = state.leftStick.x;
+    if (columns.leftStickY) columns.leftStickY[row] = state.leftStick.y;
+    if (columns.rightStickX) columns.rightStickX[row] = state.rightStick.x;
+    if (columns.rightStickY) columns.rightStickY[row] = state.rightStick.y;
+    if (columns.accelerometerX) columns.accelerometerX[row] = state.accelerometer.x;
+    if (columns.accelerometerY) columns.accelerometerY[row] = state.accelerometer.y;
+    if (columns.accelerometerZ) columns.accelerometerZ[row] = state.accelerometer.z;
+    if (columns.gyroscopeX) columns.gyroscopeX[row] = state.gyroscope.x;
+    if (columns.gyroscopeY) columns.gyroscopeY[row] = state.gyroscope.y;
+    if (columns.gyroscopeZ) columns.gyroscopeZ[row] = state.gyroscope.z;
+
+    row++;
+  }
+
+  if (changesOnly && count > 0) nextIndex = (start + visited) % count;
+
+  return row;
+};
+
+size_t Joytime::FleetSnapshot::capture(Joytime::Controller* const* controllers, size_t count, Joytime::FleetSnapshotColumns& columns) {
+  return write(controllers, count, columns, false);
+};
+
+size_t Joytime::FleetSnapshot::captureChanges(Joytime::Controller* const* controllers, size_t count, Joytime::FleetSnapshotColumns& columns) {
+  return write(controllers, count, columns, true);
+};
+
+void Joytime::FleetSnapshot::reset() {
+  capturedSequences.clear();
+  nextIndex = 0;
+};
@@ -0,0 +1,292 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+// how quickly the link quality follows missed reports (about the last 100 reports)
+static const double linkQualitySmoothing = 0.01;
+// how quickly the expected report timer step follows the actual one
+static const double timerStepSmoothing = 0.1;
+// link quality has to climb this far past the threshold to stop counting as degraded
+static const double degradedHysteresis = 0.02;
+// the report timer is only 8 bits; past this long between reports, it may have wrapped
+static const std::chrono::milliseconds maxTimerGap(250);
+
+struct Joytime::HealthMonitor::Entry {
+  Joytime::Controller* controller = nullptr;
+  unsigned int updatedHandler = 0;
+
+  std::mutex mutex;
+  Joytime::ControllerHealth health;
+  bool removed = false;
+  std::chrono::steady_clock::time_point monitoredSince;
+
+  bool seenReport = false;
+  uint8_t lastTimer = 0;
+  // average timer increment between two reports
+  double timerStep = 0;
+  bool batteryLowReported = false;
+
+  // at most one of each subcommand is outstanding
+  bool deviceInfoPending = false;
+  std::chrono::steady_clock::time_point deviceInfoRetryAt;
+  bool probePending = false;
+};
+
+Joytime::HealthMonitor::HealthMonitor(bool attach) {
+  checker = std::thread(&Joytime::HealthMonitor::check, this);
+
+  if (attach) {
+    attached = true;
+    availableHandler = Joytime::controllerAvailable().on([this](Joytime::Controller* controller) {
+      add(controller);
+    });
+    removedHandler = Joytime::controllerRemoved().on([this](Joytime::Controller* controller) {
+      remove(controller);
+    });
+  }
+};
+
+Joytime::HealthMonitor::~HealthMonitor() {
+  if (attached) {
+    Joytime::controllerAvailable().removeHandler(availableHandler);
+    Joytime::controllerRemoved().removeHandler(removedHandler);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  checker.join();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto& pair: entries) {
+    {
+      std::lock_guard<std::mutex> entryLock(pair.second->mutex);
+      pair.second->removed = true;
+    }
+    pair.first->updated.removeHandler(pair.second->updatedHandler);
+  }
+  entries.clear();
+};
+
+void Joytime::HealthMonitor::add(Joytime::Controller* controller) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (stopping || entries.count(controller) > 0) return;
+
+  std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+  entry->controller = controller;
+  entry->monitoredSince = std::chrono::steady_clock::now();
+
+  std::weak_ptr<Entry> weakEntry = entry;
+  entry->updatedHandler = controller->updated.on([this, weakEntry](Joytime::Controller*) {
+    std::shared_ptr<Entry> entry = weakEntry.lock();
+    if (entry) reportReceived(entry);
+  });
+
+  entries[controller] = entry;
+};
+
+void Joytime::HealthMonitor::remove(Joytime::Controller* controller) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(controller);
+  if (it == entries.end()) return;
+
+  {
+    std::lock_guard<std::mutex> entryLock(it->second->mutex);
+    it->second->removed = true;
+  }
+  controller->updated.removeHandler(it->second->updatedHandler);
+  entries.erase(it);
+};
+
+bool Joytime::HealthMonitor::health(Joytime::Controller* controller, Joytime::ControllerHealth& health) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(controller);
+  if (it == entries.end()) return false;
+
+  std::lock_guard<std::mutex> entryLock(it->second->mutex);
+  health = it->second->health;
+  return true;
+};
+
+std::vector<Joytime::Controller*> Joytime::HealthMonitor::unhealthy() const {
+  std::vector<Joytime::Controller*> controllers;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  for (const auto& pair: entries) {
+    std::lock_guard<std::mutex> entryLock(pair.second->mutex);
+    if (pair.second->health.degraded || pair.second->health.lost) controllers.push_back(pair.first);
+  }
+
+  return controllers;
+};
+
+// on the decoding thread, after every report
+void Joytime::HealthMonitor::reportReceived(const std::shared_ptr<Entry>& entry) {
+  Joytime::ControllerState state = entry->controller->snapshot();
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+  bool low = false;
+  bool degraded = false;
+  bool restored = false;
+
+  {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (entry->removed) return;
+
+    Joytime::ControllerHealth& health = entry->health;
+    bool wasHealthy = !health.degraded && !health.lost;
+
+    // SimpleHID reports have no timer (or battery), so they leave it alone
+    uint8_t timerDelta = state.timer - entry->lastTimer;
+    bool fresh = !entry->seenReport || timerDelta != 0;
+
+    if (entry->seenReport && timerDelta != 0 && now - health.lastReportAt < maxTimerGap) {
+      if (entry->timerStep == 0) {
+        entry->timerStep = timerDelta;
+      } else if (timerDelta < entry->timerStep * 1.5) {
+        entry->timerStep += (timerDelta - entry->timerStep) * timerStepSmoothing;
+      }
+
+      long missed = std::max(std::lround(timerDelta / entry->timerStep) - 1, 0L);
+      health.missedReports += missed;
+      health.linkQuality += (1.0 / (1 + missed) - health.linkQuality) * linkQualitySmoothing;
+    }
+
+    health.reports++;
+    health.lastReportAt = now;
+    entry->seenReport = true;
+    entry->lastTimer = state.timer;
+
+    if (fresh) {
+      health.battery = state.battery;
+      health.batteryUpdatedAt = now;
+
+      bool isLow = state.battery != Joytime::ControllerBatteryStatus::Charging && (uint8_t)state.battery <= (uint8_t)lowBatteryThreshold;
+      if (isLow && !entry->batteryLowReported) low = true;
+      entry->batteryLowReported = isLow;
+    }
+
+    if (!health.degraded && health.linkQuality < degradedThreshold) {
+      health.degraded = true;
+      degraded = true;
+    } else if (health.degraded && health.linkQuality >= degradedThreshold + degradedHysteresis) {
+      health.degraded = false;
+    }
+    health.lost = false;
+
+    restored = !wasHealthy && !health.degraded;
+  }
+
+  if (low) batteryLow.emit(entry->controller);
+  if (degraded) connectionDegraded.emit(entry->controller);
+  if (restored) connectionRestored.emit(entry->controller);
+};
+
+void Joytime::HealthMonitor::check() {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+    wake.wait_for(lock, std::chrono::milliseconds(checkInterval), [this] {
+      return stopping;
+    });
+    if (stopping) return;
+
+    std::vector<std::shared_ptr<Entry>> current;
+    current.reserve(entries.size());
+    for (auto& pair: entries) current.push_back(pair.second);
+
+    lock.unlock();
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    for (const std::shared_ptr<Entry>& entry: current) checkEntry(entry, now);
+
+    lock.lock();
+  }
+};
+
+// on the checker thread
+void Joytime::HealthMonitor::checkEntry(const std::shared_ptr<Entry>& entry, std::chrono::steady_clock::time_point now) {
+  Joytime::Controller* controller = entry->controller;
+
+  bool fetchDeviceInfo = false;
+  bool probe = false;
+  bool lost = false;
+
+  {
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (entry->removed) return;
+    // controllers that aren't initialized yet are left alone
+    if (!controller->isUsable()) return;
+
+    Joytime::ControllerHealth& health = entry->health;
+    std::chrono::steady_clock::duration quiet = now - (entry->seenReport ? health.lastReportAt : entry->monitoredSince);
+    bool batteryStale = entry->seenReport && now - health.batteryUpdatedAt >= std::chrono::milliseconds(batteryRefreshInterval);
+
+    if (!health.deviceInfoKnown && !entry->deviceInfoPending && now >= entry->deviceInfoRetryAt) {
+      entry->deviceInfoPending = true;
+      fetchDeviceInfo = true;
+    }
+
+    if (!entry->probePending && (quiet >= std::chrono::milliseconds(probeTimeout) || batteryStale)) {
+      entry->probePending = true;
+      probe = true;
+    }
+
+    if (!health.lost && quiet >= std::chrono::milliseconds(lostTimeout)) {
+      health.lost = true;
+      lost = true;
+    }
+  }
+
+  std::weak_ptr<Entry> weakEntry = entry;
+  int retryInterval = probeTimeout;
+  // the monitor's subcommands time out on their own; with the controller's default of
+  // waiting forever, a quiet controller would never answer and its queue would be stuck
+  int timeout = (probeTimeout > 0) ? probeTimeout : defaultProbeTimeout;
+
+  if (fetchDeviceInfo) {
+    Joytime::DeviceInfoCallback callback = [weakEntry, retryInterval](Joytime::Controller*, const Joytime::DeviceInfo* info) {
+      std::shared_ptr<Entry> entry = weakEntry.lock();
+      if (!entry) return;
+
+      std::lock_guard<std::mutex> lock(entry->mutex);
+      entry->deviceInfoPending = false;
+      if (info != nullptr) {
+        entry->health.deviceInfo = *info;
+        entry->health.deviceInfoKnown = true;
+      } else {
+        entry->deviceInfoRetryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(retryInterval);
+      }
+    };
+
+    try {
+      controller->getDeviceInfoAsync(callback, timeout);
+    } catch (const std::exception&) {
+      callback(controller, nullptr);
+    }
+  }
+
+  if (probe) {
+    // any reply will do; it's decoded like any other report
+    Joytime::SubcommandCallback callback = [weakEntry](Joytime::Controller*, const uint8_t*, size_t) {
+      std::shared_ptr<Entry> entry = weakEntry.lock();
+      if (!entry) return;
+
+      std::lock_guard<std::mutex> lock(entry->mutex);
+      entry->probePending = false;
+    };
+
+    try {
+      controller->sendSubcommandAsync(Joytime::ControllerSubcommand::GetOnlyControllerState, nullptr, 0, callback, timeout);
+    } catch (const std::exception&) {
+      callback(controller, nullptr, 0);
+    }
+  }
+
+  if (lost) connectionLost.emit(controller);
+};
@@ -0,0 +1,259 @@
+#include "joytime-core.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+
+Joytime::IRFramePool::IRFramePool(size_t frameCount, size_t frameSize):
+  storage(frameCount * frameSize),
+  frames(frameCount) {
+  available.reserve(frameCount);
+  for (size_t i = 0; i < frameCount; i++) {
+    frames[i].data = storage.data() + i * frameSize;
+    frames[i].size = frameSize;
+    available.push_back(frameCount - 1 - i);
+  }
+};
+
+long Joytime::IRFramePool::acquire() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (available.empty()) return -1;
+
+  size_t index = available.back();
+  available.pop_back();
+  return index;
+};
+
+void Joytime::IRFramePool::release(size_t index) {
+  std::lock_guard<std::mutex> lock(mutex);
+  available.push_back(index);
+};
+
+uint8_t* Joytime::IRFramePool::buffer(size_t index) {
+  return storage.data() + index * frames[index].size;
+};
+
+Joytime::IRFrame& Joytime::IRFramePool::frame(size_t index) {
+  return frames[index];
+};
+
+size_t Joytime::IRFramePool::frameCount() const {
+  return frames.size();
+};
+
+size_t Joytime::IRFramePool::availableCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return available.size();
+};
+
+Joytime::IRFrameHandle::IRFrameHandle(std::shared_ptr<Joytime::IRFramePool> _pool, size_t _index):
+  pool(std::move(_pool)),
+  index(_index) {};
+
+Joytime::IRFrameHandle::IRFrameHandle(Joytime::IRFrameHandle&& other) noexcept:
+  pool(std::move(other.pool)),
+  index(other.index) {};
+
+Joytime::IRFrameHandle& Joytime::IRFrameHandle::operator=(Joytime::IRFrameHandle&& other) noexcept {
+  if (this != &other) {
+    release();
+    pool = std::move(other.pool);
+    index = other.index;
+  }
+  return *this;
+};
+
+Joytime::IRFrameHandle::~IRFrameHandle() {
+  release();
+};
+
+void Joytime::IRFrameHandle::release() {
+  if (!pool) return;
+  pool->release(index);
+  pool.reset();
+};
+
+Joytime::IRFrameHandle::operator bool() const {
+  return (bool)pool;
+};
+
+const Joytime::IRFrame& Joytime::IRFrameHandle::operator*() const {
+  return pool->frame(index);
+};
+
+const Joytime::IRFrame* Joytime::IRFrameHandle::operator->() const {
+  return &pool->frame(index);
+};
+
+uint16_t Joytime::IRCamera::width(Joytime::IRResolution resolution) {
+  switch (resolution) {
+    case Joytime::IRResolution::R160x120:
+      return 160;
+    case Joytime::IRResolution::R80x60:
+      return 80;
+    case Joytime::IRResolution::R40x30:
+      return 40;
+    default:
+      return 320;
+  }
+};
+
+uint16_t Joytime::IRCamera::height(Joytime::IRResolution resolution) {
+  return width(resolution) * 3 / 4;
+};
+
+uint8_t Joytime::IRCamera::lastFragment(Joytime::IRResolution resolution) {
+  return (size_t)width(resolution) * height(resolution) / Joytime::IRFrameAssembler::fragmentSize - 1;
+};
+
+// odr-used by the std::chrono constructor in `start`
+const int Joytime::IRCamera::setupTimeout;
+
+Joytime::IRCamera::IRCamera(Joytime::Controller* _controller, Joytime::IRCameraConfiguration _configuration, size_t poolSize):
+  controller(_controller),
+  configuration(_configuration),
+  // one extra frame is always being assembled
+  pool(std::make_shared<Joytime::IRFramePool>(poolSize + 1, ((size_t)lastFragment(_configuration.resolution) + 1) * Joytime::IRFrameAssembler::fragmentSize)),
+  assembler(lastFragment(_configuration.resolution), nullptr) {
+  assembling = pool->acquire();
+  assembler.setBuffer(pool->buffer(assembling));
+
+  listener = controller->addMCUListener([this](Joytime::Controller*, const Joytime::MCUReportView& report) {
+    handleReport(report);
+  });
+};
+
+Joytime::IRCamera::~IRCamera() {
+  controller->removeMCUListener(listener);
+};
+
+void Joytime::IRCamera::start() {
+  controller->setInputReportMode(Joytime::ControllerInputReportMode::NFCAndIR);
+  controller->setMCUState(Joytime::MCUState::Resume);
+
+  mcuReady = false;
+  controller->setMCUMode(Joytime::MCUMode::IR);
+
+  // the MCU takes a moment to switch modes; ask until it says it's in IR mode
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(setupTimeout);
+  while (!mcuReady) {
+    if (std::chrono::steady_clock::now() > deadline) throw std::runtime_error("Could not start the IR camera: the MCU did not switch to IR mode.");
+    controller->sendMCURequest(Joytime::MCURequest::Status);
+    controller->poll(15);
+  }
+
+  uint8_t lastFragmentNumber = lastFragment(configuration.resolution);
+
+  // image transfer mode, the number of fragments per frame and the required MCU firmware (5.18)
+  uint8_t mode[] = { (uint8_t)Joytime::IRConfigurationCommand::SetMode, 0x07, lastFragmentNumber, 0x00, 0x05, 0x00, 0x18 };
+  controller->setMCUConfiguration(Joytime::MCUConfigurationCommand::ConfigureIR, mode, sizeof(mode));
+
+  uint16_t exposure = (uint32_t)configuration.exposureMicroseconds * 31200 / 1000;
+  // page, register, value
+  uint8_t registers[][3] = {
+    { 0x00, 0x2e, (uint8_t)configuration.resolution },
+    { 0x01, 0x30, (uint8_t)(exposure & 0xff) },
+    { 0x01, 0x31, (uint8_t)(exposure >> 8) },
+    // manual exposure
+    { 0x01, 0x32, 0x00 },
+    { 0x00, 0x10, configuration.leds },
+    { 0x01, 0x2e, (uint8_t)((configuration.digitalGain & 0x0f) << 4) },
+    { 0x01, 0x2f, (uint8_t)((configuration.digitalGain & 0xf0) >> 4) },
+    // apply the new values
+    { 0x00, 0x07, 0x01 },
+  };
+  uint8_t write[2 + sizeof(registers)] = { (uint8_t)Joytime::IRConfigurationCommand::WriteRegisters, (uint8_t)(sizeof(registers) / sizeof(registers[0])) };
+  memcpy(write + 2, registers, sizeof(registers));
+  controller->setMCUConfiguration(Joytime::MCUConfigurationCommand::ConfigureIR, write, sizeof(write));
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    previousFragment = -1;
+    assembler.setBuffer(pool->buffer(assembling));
+  }
+  streaming = true;
+
+  // acknowledging "fragment 0" kicks off the stream
+  acknowledge(0);
+};
+
+void Joytime::IRCamera::stop() {
+  streaming = false;
+
+  controller->setMCUMode(Joytime::MCUMode::Standby);
+  controller->setMCUState(Joytime::MCUState::Suspend);
+  controller->setInputReportMode(Joytime::ControllerInputReportMode::StandardReport);
+};
+
+Joytime::IRCameraStatistics Joytime::IRCamera::statistics() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return stats;
+};
+
+void Joytime::IRCamera::acknowledge(uint8_t fragment, int missing) {
+  // ack, whether to resend a fragment, which one, then the fragment being acknowledged
+  uint8_t arguments[] = { 0x00, (uint8_t)(missing >= 0 ? 0x01 : 0x00), (uint8_t)(missing >= 0 ? missing : 0x00), fragment };
+  controller->sendMCURequest(Joytime::MCURequest::IR, arguments, sizeof(arguments));
+};
+
+void Joytime::IRCamera::handleReport(const Joytime::MCUReportView& report) {
+  if (report.code == Joytime::MCUReportCode::State) {
+    // byte 7 of the state report is the MCU's current mode
+    if (report.size > 7 && report.data[7] == (uint8_t)Joytime::MCUMode::IR) mcuReady = true;
+    return;
+  }
+
+  if (!streaming) return;
+
+  Joytime::IRFrameHandle completed;
+  int ackFragment;
+  int missing = -1;
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    int expected = previousFragment < 0 ? 0 : (previousFragment + 1) % (int)assembler.fragmentCount();
+    int fragment = assembler.feed(report);
+
+    if (fragment < 0) {
+      // nothing new (the MCU is waiting on us): acknowledge the last fragment again
+      if (previousFragment < 0 || report.code == Joytime::MCUReportCode::IRData) return;
+      ackFragment = previousFragment;
+    } else {
+      if (fragment > expected) {
+        missing = expected;
+        stats.fragmentsRequested++;
+      }
+      previousFragment = fragment;
+      ackFragment = fragment;
+
+      if (assembler.frameComplete()) {
+        sequence++;
+
+        long next = pool->acquire();
+        if (next < 0) {
+          // every frame is held by a consumer; reuse this one
+          stats.framesDropped++;
+          assembler.setBuffer(pool->buffer(assembling));
+        } else {
+          Joytime::IRFrame& frame = pool->frame(assembling);
+          frame.width = width(configuration.resolution);
+          frame.height = height(configuration.resolution);
+          frame.sequence = sequence;
+          frame.completedAt = std::chrono::steady_clock::now();
+
+          completed = Joytime::IRFrameHandle(pool, assembling);
+          stats.framesDelivered++;
+
+          assembling = next;
+          assembler.setBuffer(pool->buffer(assembling));
+        }
+      }
+    }
+  }
+
+  acknowledge(ackFragment, missing);
+
+  if (completed && onFrame) onFrame(controller, completed);
+};
@@ -2,23 +2,79 @@
 #include "joytime-core.hpp"
 #include <string.h> /* memcpy */
 
+// the C handle type, so pointers to a `Rumble` can be formed at compile time
+struct _Joytime_Rumble: Joytime::Rumble {
+  using Joytime::Rumble::Rumble;
+};
+
+static_assert(sizeof(Joytime_PacketView) == sizeof(Joytime::PacketView), "Joytime_PacketView must match Joytime::PacketView");
+static_assert(sizeof(Joytime_ConstPacketView) == sizeof(Joytime::ConstPacketView), "Joytime_ConstPacketView must match Joytime::ConstPacketView");
+// samples are read straight into the caller's array
+static_assert(sizeof(Joytime_SixAxisSample) == sizeof(Joytime::SixAxisSample), "Joytime_SixAxisSample must match Joytime::SixAxisSample");
+static_assert(offsetof(Joytime_SixAxisSample, accelerometer) == offsetof(Joytime::SixAxisSample, accelerometer), "Joytime_SixAxisSample must match Joytime::SixAxisSample");
+static_assert(offsetof(Joytime_SixAxisSample, gyroscope) == offsetof(Joytime::SixAxisSample, gyroscope), "Joytime_SixAxisSample must match Joytime::SixAxisSample");
+
+namespace {
+  // adapts a C transport function table to Joytime::Transport
+  class FunctionTableTransport: public Joytime::Transport {
+    private:
+      Joytime_Transport table;
+    public:
+      FunctionTableTransport(const Joytime_Transport* _table):
+        table(*_table) {};
+      ~FunctionTableTransport() {
+        if (table.destroy != NULL) table.destroy(table.userData);
+      };
+
+      int send(const uint8_t* data, size_t size) override {
+        return table.send(table.userData, data, size);
+      };
+      int receive(uint8_t* data, size_t capacity, int timeout) override {
+        return table.receive(table.userData, data, capacity, timeout);
+      };
+      size_t sendBatch(const Joytime::ConstPacketView* packets, size_t count) override {
+        if (table.sendBatch == NULL) return Joytime::Transport::sendBatch(packets, count);
+        return table.sendBatch(table.userData, (const Joytime_ConstPacketView*)packets, count);
+      };
+      size_t receiveBatch(Joytime::PacketView* packets, size_t count, int timeout) override {
+        if (table.receiveBatch == NULL) return Joytime::Transport::receiveBatch(packets, count, timeout);
+        return table.receiveBatch(table.userData, (Joytime_PacketView*)packets, count, timeout);
+      };
+      int readFD() const override {
+        return (table.readFD == NULL) ? -1 : table.readFD(table.userData);
+      };
+      int writeFD() const override {
+        return (table.writeFD == NULL) ? -1 : table.writeFD(table.userData);
+      };
+  };
+};
+
+// adapts a C completion callback and its user data
+static Joytime::CompletionCallback completion(Joytime_CompletionCallback* callback, void* userData) {
+  if (callback == nullptr) return nullptr;
+
+  return [callback, userData](Joytime::Controller* controller, bool success) {
+    callback((Joytime_Controller*)controller, success, userData);
+  };
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
 
 JOYTIME_CORE_EXPORT Joytime_Rumble* Joytime_Rumble_newFromFreqAndAmpSame(double frequency, double amplitude) {
-  Joytime::Rumble* rumble = new Joytime::Rumble(frequency, amplitude);
-  return (Joytime_Rumble*)rumble;
+  Joytime_Rumble* rumble = new _Joytime_Rumble(frequency, amplitude);
+  return rumble;
 };
 
 JOYTIME_CORE_EXPORT Joytime_Rumble* Joytime_Rumble_newFromFreqAndAmpDiff(double highFrequency, double highAmplitude, double lowFrequency, double lowAmplitude) {
-  Joytime::Rumble* rumble = new Joytime::Rumble(highFrequency, highAmplitude, lowFrequency, lowAmplitude);
-  return (Joytime_Rumble*)rumble;
+  Joytime_Rumble* rumble = new _Joytime_Rumble(highFrequency, highAmplitude, lowFrequency, lowAmplitude);
+  return rumble;
 };
 
 JOYTIME_CORE_EXPORT Joytime_Rumble* Joytime_Rumble_newFromPreencoded(uint16_t highFrequency, uint8_t highAmplitude, uint8_t lowFrequency, uint16_t lowAmplitude) {
-  Joytime::Rumble* rumble = new Joytime::Rumble(highFrequency, highAmplitude, lowFrequency, lowAmplitude);
-  return (Joytime_Rumble*)rumble;
+  Joytime_Rumble* rumble = new _Joytime_Rumble(highFrequency, highAmplitude, lowFrequency, lowAmplitude);
+  return rumble;
 };
 
 JOYTIME_CORE_EXPORT uint8_t* Joytime_Rumble_toBuffer(Joytime_Rumble* _rumble) {
@@ -26,6 +82,12 @@ JOYTIME_CORE_EXPORT uint8_t* Joytime_Rumble_toBuffer(Joytime_Rumble* _rumble) {
   return rumble->toBuffer();
 };
 
+JOYTIME_CORE_EXPORT void Joytime_Rumble_encode(Joytime_Rumble* _rumble, uint8_t* buffer) {
+  Joytime::Rumble* rumble = (Joytime::Rumble*)_rumble;
+  Joytime::EncodedRumble encoded = rumble->encoded();
+  memcpy(buffer, encoded.data(), encoded.size());
+};
+
 JOYTIME_CORE_EXPORT uint16_t* Joytime_Rumble_getHighFrequency(Joytime_Rumble* _rumble) {
   Joytime::Rumble* rumble = (Joytime::Rumble*)_rumble;
   return &(rumble->highFrequency);
@@ -64,6 +126,15 @@ JOYTIME_CORE_EXPORT Joytime_Controller* Joytime_Controller_new(Joytime_Controlle
   return (Joytime_Controller*)controller;
 };
 
+JOYTIME_CORE_EXPORT Joytime_Controller* Joytime_Controller_newWithTransport(Joytime_ControllerType type, void* handle, const Joytime_Transport* transport) {
+  // `send` and `receive` are required
+  if (transport == NULL || transport->send == NULL || transport->receive == NULL) return NULL;
+
+  std::shared_ptr<Joytime::Transport> wrapped = std::make_shared<FunctionTableTransport>(transport);
+  Joytime::Controller* controller = new Joytime::Controller((Joytime::ControllerType)type, handle, wrapped);
+  return (Joytime_Controller*)controller;
+};
+
 JOYTIME_CORE_EXPORT void Joytime_Controller_free(Joytime_Controller* _controller) {
   Joytime::Controller* controller = (Joytime::Controller*)_controller;
   delete controller;
@@ -105,6 +176,12 @@ JOYTIME_CORE_EXPORT void Joytime_Controller_rumbleEach(Joytime_Controller* _cont
   controller->rumble(timing, (Joytime::Rumble*)rumble1, (Joytime::Rumble*)rumble2);
 };
 
+JOYTIME_CORE_EXPORT void Joytime_Controller_rumbleEncoded(Joytime_Controller* _controller, uint8_t timing, const uint8_t* leftFrame, const uint8_t* rightFrame) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  controller->rumbleEncoded(timing, leftFrame, rightFrame);
+};
+
 JOYTIME_CORE_EXPORT void Joytime_Controller_setLEDs(Joytime_Controller* _controller, Joytime_ControllerLEDState led1, Joytime_ControllerLEDState led2, Joytime_ControllerLEDState led3, Joytime_ControllerLEDState led4) {
   Joytime::Controller* controller = (Joytime::Controller*)_controller;
 
@@ -154,6 +231,96 @@ JOYTIME_CORE_EXPORT void Joytime_Controller_removeUpdateListener(Joytime_Control
   controller->updated.removeHandler(id);
 };
 
+JOYTIME_CORE_EXPORT size_t Joytime_Controller_poll(Joytime_Controller* _controller, int timeout) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  return controller->poll(timeout);
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_snapshot(Joytime_Controller* _controller, Joytime_ControllerState* state) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+  Joytime::ControllerState snapshot = controller->snapshot();
+
+  state->sequence = snapshot.sequence;
+  state->timer = snapshot.timer;
+  state->battery = (uint8_t)snapshot.battery;
+  state->buttons = Joytime::packButtons(snapshot.buttons);
+  state->leftStick.x = snapshot.leftStick.x;
+  state->leftStick.y = snapshot.leftStick.y;
+  state->rightStick.x = snapshot.rightStick.x;
+  state->rightStick.y = snapshot.rightStick.y;
+  state->accelerometer.x = snapshot.accelerometer.x;
+  state->accelerometer.y = snapshot.accelerometer.y;
+  state->accelerometer.z = snapshot.accelerometer.z;
+  state->gyroscope.x = snapshot.gyroscope.x;
+  state->gyroscope.y = snapshot.gyroscope.y;
+  state->gyroscope.z = snapshot.gyroscope.z;
+};
+
+JOYTIME_CORE_EXPORT size_t Joytime_Controller_readSixAxisSamples(Joytime_Controller* _controller, Joytime_SixAxisSample* samples, size_t capacity) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  return controller->readSixAxisSamples((Joytime::SixAxisSample*)samples, capacity);
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_getStatistics(Joytime_Controller* _controller, Joytime_ControllerStatistics* statistics) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+  Joytime::ControllerStatistics counters = controller->statistics();
+
+  statistics->reports = counters.reports;
+  statistics->truncatedReports = counters.truncatedReports;
+  statistics->subcommandsSent = counters.subcommandsSent;
+  statistics->subcommandsFailed = counters.subcommandsFailed;
+  statistics->rumblesSent = counters.rumblesSent;
+  statistics->rumblesSkipped = counters.rumblesSkipped;
+  statistics->sixAxisSamplesDropped = counters.sixAxisSamplesDropped;
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_initializeAsync(Joytime_Controller* _controller, bool calibrate, Joytime_CompletionCallback* callback, void* userData) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  controller->initializeAsync(calibrate, completion(callback, userData));
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_setVibrateAsync(Joytime_Controller* _controller, bool vibrate, Joytime_CompletionCallback* callback, void* userData) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  controller->setVibrationAsync(vibrate, completion(callback, userData));
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_setSixAxisEnabledAsync(Joytime_Controller* _controller, bool enabled, Joytime_CompletionCallback* callback, void* userData) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  controller->setSixAxisEnabledAsync(enabled, completion(callback, userData));
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_setInputReportModeAsync(Joytime_Controller* _controller, Joytime_ControllerInputReportMode mode, Joytime_CompletionCallback* callback, void* userData) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  controller->setInputReportModeAsync((Joytime::ControllerInputReportMode)mode, completion(callback, userData));
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_setLEDsAsync(Joytime_Controller* _controller, Joytime_ControllerLEDState led1, Joytime_ControllerLEDState led2, Joytime_ControllerLEDState led3, Joytime_ControllerLEDState led4, Joytime_CompletionCallback* callback, void* userData) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  controller->setLEDsAsync((Joytime::ControllerLEDState)led1, (Joytime::ControllerLEDState)led2, (Joytime::ControllerLEDState)led3, (Joytime::ControllerLEDState)led4, completion(callback, userData));
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_setPowerStateAsync(Joytime_Controller* _controller, Joytime_ControllerPowerState state, Joytime_CompletionCallback* callback, void* userData) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+
+  controller->setPowerStateAsync((Joytime::ControllerPowerState)state, completion(callback, userData));
+};
+
+JOYTIME_CORE_EXPORT void Joytime_Controller_readSPIFlashAsync(Joytime_Controller* _controller, int32_t address, uint8_t length, Joytime_SPIFlashCallback* callback, void* userData) {
+  Joytime::Controller* controller = (Joytime::Controller*)_controller;
+  if (callback == nullptr) return controller->readSPIFlashAsync(address, length, nullptr);
+
+  controller->readSPIFlashAsync(address, length, [callback, userData](Joytime::Controller* controller, const uint8_t* data, size_t size) {
+    callback((Joytime_Controller*)controller, data, size, userData);
+  });
+};
+
 JOYTIME_CORE_EXPORT int* Joytime_Controller_getInterval(Joytime_Controller* _controller) {
   Joytime::Controller* controller = (Joytime::Controller*)_controller;
   return &(controller->interval);
@@ -207,8 +374,16 @@ JOYTIME_CORE_EXPORT Joytime_SixAxis* Joytime_Controller_getGyroscope(Joytime_Con
   return (Joytime_SixAxis*)(&(controller->gyroscope));
 };
 
-JOYTIME_CORE_EXPORT Joytime_Rumble* Joytime_neutralRumble = Joytime_Rumble_newFromFreqAndAmpDiff(320.0, 0.0, 160.0, 0.0);
-JOYTIME_CORE_EXPORT uint8_t* Joytime_neutralRumbleBufffer = Joytime_Rumble_toBuffer(Joytime_neutralRumble);
+static JOYTIME_CORE_CONSTINIT _Joytime_Rumble neutralRumble((uint16_t)0x0100, (uint8_t)0x00, (uint8_t)0x40, (uint16_t)0x0040);
+static uint8_t neutralRumbleBuffer[4] = {
+  Joytime::neutralRumbleEncoded[0],
+  Joytime::neutralRumbleEncoded[1],
+  Joytime::neutralRumbleEncoded[2],
+  Joytime::neutralRumbleEncoded[3],
+};
+
+JOYTIME_CORE_EXPORT JOYTIME_CORE_CONSTINIT Joytime_Rumble* Joytime_neutralRumble = &neutralRumble;
+JOYTIME_CORE_EXPORT JOYTIME_CORE_CONSTINIT uint8_t* Joytime_neutralRumbleBuffer = neutralRumbleBuffer;
 
 #ifdef __cplusplus
 }
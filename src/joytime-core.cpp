@@ -1,10 +1,30 @@
 #include "joytime-core.hpp"
 #include "joytime_core_EXPORTS.h"
 
+// Rumble(320.0, 0.0, 160.0, 0.0), pre-encoded so it doesn't need a dynamic initializer
+static constexpr Joytime::Rumble preencodedNeutralRumble((uint16_t)0x0100, (uint8_t)0x00, (uint8_t)0x40, (uint16_t)0x0040);
+static_assert(preencodedNeutralRumble.encoded()[0] == Joytime::neutralRumbleEncoded[0], "neutral rumble mismatch");
+static_assert(preencodedNeutralRumble.encoded()[1] == Joytime::neutralRumbleEncoded[1], "neutral rumble mismatch");
+static_assert(preencodedNeutralRumble.encoded()[2] == Joytime::neutralRumbleEncoded[2], "neutral rumble mismatch");
+static_assert(preencodedNeutralRumble.encoded()[3] == Joytime::neutralRumbleEncoded[3], "neutral rumble mismatch");
+
+static uint8_t neutralRumbleBytes[4] = {
+  Joytime::neutralRumbleEncoded[0],
+  Joytime::neutralRumbleEncoded[1],
+  Joytime::neutralRumbleEncoded[2],
+  Joytime::neutralRumbleEncoded[3],
+};
+
 namespace Joytime {
-  JOYTIME_CORE_EXPORT Joytime::Rumble neutralRumble = Joytime::Rumble(320.0, 0.0, 160.0, 0.0);
-  JOYTIME_CORE_EXPORT uint8_t* neutralRumbleBuffer = neutralRumble.toBuffer();
-  JOYTIME_CORE_EXPORT std::vector<uint8_t> neutralRumbleVector = neutralRumble.toVector();
-  JOYTIME_CORE_EXPORT EventEmitter<Joytime::Controller*> controllerAvailable;
-  JOYTIME_CORE_EXPORT EventEmitter<Joytime::Controller*> controllerRemoved;
+  JOYTIME_CORE_EXPORT JOYTIME_CORE_CONSTINIT Joytime::Rumble neutralRumble = preencodedNeutralRumble;
+  JOYTIME_CORE_EXPORT JOYTIME_CORE_CONSTINIT uint8_t* neutralRumbleBuffer = neutralRumbleBytes;
+
+  JOYTIME_CORE_EXPORT EventEmitter<Joytime::Controller*>& controllerAvailable() {
+    static EventEmitter<Joytime::Controller*> emitter;
+    return emitter;
+  };
+  JOYTIME_CORE_EXPORT EventEmitter<Joytime::Controller*>& controllerRemoved() {
+    static EventEmitter<Joytime::Controller*> emitter;
+    return emitter;
+  };
 };
@@ -0,0 +1,76 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+uint8_t Joytime::mcuCRC8(const uint8_t* data, size_t size) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+};
+
+Joytime::IRFrameAssembler::IRFrameAssembler(uint8_t _lastFragment):
+  frame(((size_t)_lastFragment + 1) * fragmentSize),
+  target(frame.data()),
+  received((size_t)_lastFragment + 1),
+  lastFragment(_lastFragment) {};
+
+Joytime::IRFrameAssembler::IRFrameAssembler(uint8_t _lastFragment, uint8_t* buffer):
+  target(buffer),
+  received((size_t)_lastFragment + 1),
+  lastFragment(_lastFragment) {};
+
+void Joytime::IRFrameAssembler::reset() {
+  std::fill(received.begin(), received.end(), false);
+  receivedCount = 0;
+  complete = false;
+};
+
+void Joytime::IRFrameAssembler::setBuffer(uint8_t* buffer) {
+  target = buffer;
+  reset();
+};
+
+int Joytime::IRFrameAssembler::feed(const Joytime::MCUReportView& report) {
+  if (report.code != Joytime::MCUReportCode::IRData) return -1;
+  if (report.size < fragmentDataOffset + fragmentSize) return -1;
+
+  uint8_t fragment = report.data[fragmentNumberOffset];
+  if (fragment > lastFragment) return -1;
+
+  // fragments arrive in order (repeated ones are resends), so going
+  // backwards means a new frame has started
+  if (fragment < previousFragment || (complete && fragment != previousFragment)) reset();
+  previousFragment = fragment;
+
+  memcpy(target + fragment * fragmentSize, report.data + fragmentDataOffset, fragmentSize);
+  if (!received[fragment]) {
+    received[fragment] = true;
+    receivedCount++;
+  }
+
+  if (receivedCount == received.size()) complete = true;
+
+  return fragment;
+};
+
+bool Joytime::IRFrameAssembler::frameComplete() const {
+  return complete;
+};
+
+const uint8_t* Joytime::IRFrameAssembler::data() const {
+  return target;
+};
+
+size_t Joytime::IRFrameAssembler::size() const {
+  return received.size() * fragmentSize;
+};
+
+size_t Joytime::IRFrameAssembler::fragmentCount() const {
+  return received.size();
+};
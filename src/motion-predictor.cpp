@@ -0,0 +1,311 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+static const double pi = 3.14159265358979323846;
+// how quickly the report time origin follows reports that arrive later than the
+// earliest seen, to make up for the controller's clock running at a slightly different rate
+static const double originSmoothing = 0.001;
+// used for reports that can't be told apart in time, in seconds
+static const double minimumInterval = 0.001;
+
+const int Joytime::MotionPredictor::timerTickMicroseconds;
+
+Joytime::OneEuroFilter::OneEuroFilter(double _minCutoff, double _beta, double _derivativeCutoff):
+  minCutoff(_minCutoff),
+  beta(_beta),
+  derivativeCutoff(_derivativeCutoff) {};
+
+// smoothing factor of an exponential filter with the given cutoff frequency
+static double smoothingFactor(double cutoff, double interval) {
+  double timeConstant = 1.0 / (2 * pi * cutoff);
+  return 1.0 / (1.0 + timeConstant / interval);
+};
+
+double Joytime::OneEuroFilter::filter(double value, double interval) {
+  if (!started || interval <= 0) {
+    if (!started) {
+      started = true;
+      value_ = value;
+      rawValue = value;
+      derivative_ = 0;
+    }
+    return value_;
+  }
+
+  double derivative = (value - rawValue) / interval;
+  rawValue = value;
+  derivative_ += smoothingFactor(derivativeCutoff, interval) * (derivative - derivative_);
+
+  double cutoff = minCutoff + beta * std::abs(derivative_);
+  value_ += smoothingFactor(cutoff, interval) * (value - value_);
+
+  return value_;
+};
+
+double Joytime::OneEuroFilter::value() const {
+  return value_;
+};
+
+double Joytime::OneEuroFilter::derivative() const {
+  return derivative_;
+};
+
+void Joytime::OneEuroFilter::reset() {
+  started = false;
+  value_ = 0;
+  rawValue = 0;
+  derivative_ = 0;
+};
+
+// rotates `orientation` by `gyroscope` (degrees per second, in the controller's frame) for `interval` seconds
+static Joytime::Quaternion rotate(const Joytime::Quaternion& orientation, const Joytime::SixAxis& gyroscope, double interval) {
+  double x = gyroscope.x * pi / 180.0 * interval;
+  double y = gyroscope.y * pi / 180.0 * interval;
+  double z = gyroscope.z * pi / 180.0 * interval;
+  double angle = std::sqrt(x * x + y * y + z * z);
+  if (angle == 0) return orientation;
+
+  double s = std::sin(angle / 2) / angle;
+  Joytime::Quaternion delta;
+  delta.w = std::cos(angle / 2);
+  delta.x = x * s;
+  delta.y = y * s;
+  delta.z = z * s;
+
+  Joytime::Quaternion result;
+  result.w = orientation.w * delta.w - orientation.x * delta.x - orientation.y * delta.y - orientation.z * delta.z;
+  result.x = orientation.w * delta.x + orientation.x * delta.w + orientation.y * delta.z - orientation.z * delta.y;
+  result.y = orientation.w * delta.y - orientation.x * delta.z + orientation.y * delta.w + orientation.z * delta.x;
+  result.z = orientation.w * delta.z + orientation.x * delta.y - orientation.y * delta.x + orientation.z * delta.w;
+
+  // keep rounding errors from piling up
+  double norm = std::sqrt(result.w * result.w + result.x * result.x + result.y * result.y + result.z * result.z);
+  result.w /= norm;
+  result.x /= norm;
+  result.y /= norm;
+  result.z /= norm;
+
+  return result;
+};
+
+static double seconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration<double>(duration).count();
+};
+
+Joytime::MotionPredictor::MotionPredictor() {
+  setStickFilter(defaultStickMinCutoff, defaultStickBeta);
+  setGyroscopeFilter(defaultGyroscopeMinCutoff, defaultGyroscopeBeta);
+};
+
+Joytime::MotionPredictor::MotionPredictor(Joytime::Controller* _controller):
+  MotionPredictor() {
+  controller = _controller;
+  updatedHandler = controller->updated.on([this](Joytime::Controller* controller) {
+    update(controller->snapshot());
+  });
+};
+
+Joytime::MotionPredictor::~MotionPredictor() {
+  if (controller) controller->updated.removeHandler(updatedHandler);
+};
+
+void Joytime::MotionPredictor::setStickFilter(double minCutoff, double beta) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (OneEuroFilter* filter: { &leftStickX, &leftStickY, &rightStickX, &rightStickY }) {
+    filter->minCutoff = minCutoff;
+    filter->beta = beta;
+  }
+};
+
+void Joytime::MotionPredictor::setGyroscopeFilter(double minCutoff, double beta) {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (OneEuroFilter* filter: { &gyroscopeX, &gyroscopeY, &gyroscopeZ }) {
+    filter->minCutoff = minCutoff;
+    filter->beta = beta;
+  }
+};
+
+std::chrono::steady_clock::time_point Joytime::MotionPredictor::reportTime(uint8_t timer, std::chrono::steady_clock::time_point receivedAt, bool& timed) {
+  const std::chrono::microseconds tick(timerTickMicroseconds);
+  timed = true;
+
+  if (!started) {
+    started = true;
+    ticks = 0;
+    origin = receivedAt;
+    lastTimer = timer;
+    lastReceivedAt = receivedAt;
+    return receivedAt;
+  }
+
+  // reports without a timer (SimpleHID) leave it unchanged; all there is to go by is when they arrived
+  uint8_t elapsed = timer - lastTimer;
+  if (elapsed == 0) {
+    timed = false;
+    return receivedAt;
+  }
+
+  // the timer is 8 bits wide. after more than half a wrap, it may have wrapped
+  // more than once, so take the number of wraps from the host's clock
+  uint64_t step = elapsed;
+  double hostTicks = seconds(receivedAt - lastReceivedAt) / seconds(tick);
+  if (hostTicks > 128) step += 256 * (uint64_t)std::max(std::llround((hostTicks - elapsed) / 256.0), 0LL);
+
+  ticks += step;
+  lastTimer = timer;
+  lastReceivedAt = receivedAt;
+
+  // the report was sent `ticks` ticks after `origin`. a report can't arrive before it's
+  // sent, so the earliest arrival so far is the best guess for the origin
+  std::chrono::steady_clock::time_point candidate = receivedAt - tick * ticks;
+  if (candidate < origin) {
+    origin = candidate;
+  } else {
+    origin += std::chrono::duration_cast<std::chrono::steady_clock::duration>((candidate - origin) * originSmoothing);
+  }
+
+  return origin + tick * ticks;
+};
+
+void Joytime::MotionPredictor::update(const Joytime::ControllerState& state, std::chrono::steady_clock::time_point receivedAt) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  bool timed;
+  std::chrono::steady_clock::time_point time = reportTime(state.timer, receivedAt, timed);
+
+  const MotionState* previous = nullptr;
+  if (historyCount > 0) previous = &history[(historyStart + historyCount - 1) % historySize];
+  if (previous && time < previous->time) time = previous->time;
+
+  double interval = previous ? seconds(time - previous->time) : 0;
+  if (previous && interval <= 0) interval = minimumInterval;
+
+  MotionState next;
+  next.time = time;
+  next.leftStick.x = leftStickX.filter(state.leftStick.x, interval);
+  next.leftStick.y = leftStickY.filter(state.leftStick.y, interval);
+  next.rightStick.x = rightStickX.filter(state.rightStick.x, interval);
+  next.rightStick.y = rightStickY.filter(state.rightStick.y, interval);
+
+  // reports without a timer don't have new IMU data either
+  if (timed) {
+    // integrate the raw readings; filtering them first would only add lag
+    if (previous) orientation = rotate(orientation, state.gyroscope, interval);
+
+    gyroscopeX.filter(state.gyroscope.x, interval);
+    gyroscopeY.filter(state.gyroscope.y, interval);
+    gyroscopeZ.filter(state.gyroscope.z, interval);
+  }
+  next.gyroscope.x = gyroscopeX.value();
+  next.gyroscope.y = gyroscopeY.value();
+  next.gyroscope.z = gyroscopeZ.value();
+  next.orientation = orientation;
+
+  if (historyCount < historySize) {
+    history[(historyStart + historyCount) % historySize] = next;
+    historyCount++;
+  } else {
+    history[historyStart] = next;
+    historyStart = (historyStart + 1) % historySize;
+  }
+};
+
+// extrapolates the latest state (whose derivatives are in the filters) to `time`
+Joytime::MotionState Joytime::MotionPredictor::predict(const Joytime::MotionState& state, std::chrono::steady_clock::time_point time) const {
+  double ahead = std::min(seconds(time - state.time), maxPrediction / 1000.0);
+
+  Joytime::MotionState predicted = state;
+  predicted.time = time;
+  predicted.leftStick.x += leftStickX.derivative() * ahead;
+  predicted.leftStick.y += leftStickY.derivative() * ahead;
+  predicted.rightStick.x += rightStickX.derivative() * ahead;
+  predicted.rightStick.y += rightStickY.derivative() * ahead;
+  predicted.orientation = rotate(state.orientation, state.gyroscope, ahead);
+
+  return predicted;
+};
+
+static double interpolate(double a, double b, double t) {
+  return a + (b - a) * t;
+};
+
+Joytime::MotionState Joytime::MotionPredictor::stateAt(std::chrono::steady_clock::time_point time) const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  Joytime::MotionState state;
+  state.time = time;
+  if (historyCount == 0) return state;
+
+  const MotionState& last = history[(historyStart + historyCount - 1) % historySize];
+  if (time >= last.time) return predict(last, time);
+
+  const MotionState& first = history[historyStart];
+  if (time <= first.time) {
+    state = first;
+    state.time = time;
+    return state;
+  }
+
+  // find the two states on either side of `time`
+  size_t i = historyCount - 1;
+  while (i > 0 && history[(historyStart + i - 1) % historySize].time > time) i--;
+  const MotionState& a = history[(historyStart + i - 1) % historySize];
+  const MotionState& b = history[(historyStart + i) % historySize];
+
+  double t = seconds(time - a.time) / seconds(b.time - a.time);
+
+  state.leftStick.x = interpolate(a.leftStick.x, b.leftStick.x, t);
+  state.leftStick.y = interpolate(a.leftStick.y, b.leftStick.y, t);
+  state.rightStick.x = interpolate(a.rightStick.x, b.rightStick.x, t);
+  state.rightStick.y = interpolate(a.rightStick.y, b.rightStick.y, t);
+  state.gyroscope.x = interpolate(a.gyroscope.x, b.gyroscope.x, t);
+  state.gyroscope.y = interpolate(a.gyroscope.y, b.gyroscope.y, t);
+  state.gyroscope.z = interpolate(a.gyroscope.z, b.gyroscope.z, t);
+
+  // normalized linear interpolation, taking the shorter way around
+  const Joytime::Quaternion& p = a.orientation;
+  Joytime::Quaternion q = b.orientation;
+  if (p.w * q.w + p.x * q.x + p.y * q.y + p.z * q.z < 0) {
+    q.w = -q.w;
+    q.x = -q.x;
+    q.y = -q.y;
+    q.z = -q.z;
+  }
+  Joytime::Quaternion& r = state.orientation;
+  r.w = interpolate(p.w, q.w, t);
+  r.x = interpolate(p.x, q.x, t);
+  r.y = interpolate(p.y, q.y, t);
+  r.z = interpolate(p.z, q.z, t);
+  double norm = std::sqrt(r.w * r.w + r.x * r.x + r.y * r.y + r.z * r.z);
+  r.w /= norm;
+  r.x /= norm;
+  r.y /= norm;
+  r.z /= norm;
+
+  return state;
+};
+
+Joytime::MotionState Joytime::MotionPredictor::latest() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (historyCount == 0) return Joytime::MotionState();
+  return history[(historyStart + historyCount - 1) % historySize];
+};
+
+void Joytime::MotionPredictor::resetOrientation(const Joytime::Quaternion& _orientation) {
+  std::lock_guard<std::mutex> lock(mutex);
+  // applies from the next report on; the history is left as it was
+  orientation = _orientation;
+};
+
+void Joytime::MotionPredictor::reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (OneEuroFilter* filter: { &leftStickX, &leftStickY, &rightStickX, &rightStickY, &gyroscopeX, &gyroscopeY, &gyroscopeZ }) {
+    filter->reset();
+  }
+  orientation = Joytime::Quaternion();
+  started = false;
+  historyStart = 0;
+  historyCount = 0;
+};
@@ -0,0 +1,146 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+static size_t roundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) result <<= 1;
+  return result;
+};
+
+Joytime::ReportQueue::ReportQueue(size_t _capacity, Joytime::ReportQueueOverflowPolicy _policy):
+  slots(new Slot[roundUpToPowerOfTwo(std::max(_capacity, (size_t)2))]),
+  mask(roundUpToPowerOfTwo(std::max(_capacity, (size_t)2)) - 1),
+  policy(_policy),
+  head(0),
+  tail(0),
+  pushed(0),
+  dropped(0),
+  popped(0),
+  highWatermark(0) {
+  for (size_t i = 0; i <= mask; i++) {
+    slots[i].stamp.store(0, std::memory_order_relaxed);
+    slots[i].size = 0;
+  }
+};
+
+void Joytime::ReportQueue::dropOldest() {
+  size_t h = head.load(std::memory_order_acquire);
+  // if this fails, the consumer just popped it, which frees the slot just the same
+  if (head.compare_exchange_strong(h, h + 1, std::memory_order_acq_rel)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+};
+
+void Joytime::ReportQueue::publish(size_t position, size_t size) {
+  Slot& slot = slots[position & mask];
+
+  slot.size = (uint16_t)size;
+  slot.stamp.store(2 * position + 2, std::memory_order_release);
+  tail.store(position + 1, std::memory_order_release);
+  pushed.fetch_add(1, std::memory_order_relaxed);
+
+  size_t used = position + 1 - head.load(std::memory_order_relaxed);
+  size_t watermark = highWatermark.load(std::memory_order_relaxed);
+  while (used > watermark && !highWatermark.compare_exchange_weak(watermark, used, std::memory_order_relaxed));
+};
+
+bool Joytime::ReportQueue::push(const uint8_t* data, size_t size) {
+  size_t t = tail.load(std::memory_order_relaxed);
+
+  if (t - head.load(std::memory_order_acquire) > mask) {
+    if (policy == Joytime::ReportQueueOverflowPolicy::DropNewest) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    dropOldest();
+  }
+
+  Slot& slot = slots[t & mask];
+  slot.stamp.store(2 * t + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  size = std::min(size, sizeof(slot.data));
+  memcpy(slot.data, data, size);
+  publish(t, size);
+
+  return true;
+};
+
+size_t Joytime::ReportQueue::receiveFrom(Joytime::Transport* transport, int timeout, size_t maxReports, Joytime::ReportObserver* observer, void* context) {
+  size_t t = tail.load(std::memory_order_relaxed);
+  size_t free = (mask + 1) - (t - head.load(std::memory_order_acquire));
+  size_t count = std::min({ maxReports, maxBatchSize, free });
+
+  if (count == 0) {
+    // full: receive into a scratch buffer first, so nothing is dropped unless a
+    // report actually arrives, and let `push` apply the overflow policy
+    uint8_t scratch[Joytime::Transport::maxPacketSize];
+    int bytesRead = transport->receive(scratch, sizeof(scratch), timeout);
+    if (bytesRead <= 0) return 0;
+    if (observer != nullptr) observer(context, scratch, bytesRead);
+    push(scratch, bytesRead);
+    return 1;
+  }
+
+  Joytime::PacketView views[maxBatchSize];
+  for (size_t i = 0; i < count; i++) {
+    Slot& slot = slots[(t + i) & mask];
+    slot.stamp.store(2 * (t + i) + 1, std::memory_order_relaxed);
+    views[i].data = slot.data;
+    views[i].size = sizeof(slot.data);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+
+  size_t received = transport->receiveBatch(views, count, timeout);
+  for (size_t i = 0; i < received; i++) {
+    if (observer != nullptr) observer(context, views[i].data, views[i].size);
+    publish(t + i, views[i].size);
+  }
+
+  return received;
+};
+
+size_t Joytime::ReportQueue::pop(uint8_t* data) {
+  while (true) {
+    size_t h = head.load(std::memory_order_acquire);
+    if (h == tail.load(std::memory_order_acquire)) return 0;
+
+    // seqlock-style read: if the producer overwrote the slot while we were copying
+    // it (only possible with DropOldest), the stamp changes and we try again
+    Slot& slot = slots[h & mask];
+    size_t stamp = slot.stamp.load(std::memory_order_acquire);
+    if (stamp != 2 * h + 2) continue;
+
+    size_t size = slot.size;
+    memcpy(data, slot.data, size);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.stamp.load(std::memory_order_relaxed) != stamp) continue;
+
+    if (head.compare_exchange_strong(h, h + 1, std::memory_order_acq_rel)) {
+      popped.fetch_add(1, std::memory_order_relaxed);
+      return size;
+    }
+  }
+};
+
+size_t Joytime::ReportQueue::size() const {
+  return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+};
+
+size_t Joytime::ReportQueue::capacity() const {
+  return mask + 1;
+};
+
+Joytime::ReportQueueStatistics Joytime::ReportQueue::statistics() const {
+  Joytime::ReportQueueStatistics stats;
+
+  stats.pushed = pushed.load(std::memory_order_relaxed);
+  stats.popped = popped.load(std::memory_order_relaxed);
+  stats.dropped = dropped.load(std::memory_order_relaxed);
+  stats.highWatermark = highWatermark.load(std::memory_order_relaxed);
+
+  return stats;
+};
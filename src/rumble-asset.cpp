@@ -0,0 +1,256 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char assetMagic[4] = { 'J', 'T', 'R', 'A' };
+
+static uint16_t readU16(const uint8_t* in) {
+  return in[0] | (in[1] << 8);
+};
+
+static uint32_t readU32(const uint8_t* in) {
+  return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+};
+
+static void writeU16(uint8_t* out, uint16_t value) {
+  out[0] = value & 0xff;
+  out[1] = value >> 8;
+};
+
+static void writeU32(uint8_t* out, uint32_t value) {
+  for (int i = 0; i < 4; i++) out[i] = (value >> (i * 8)) & 0xff;
+};
+
+Joytime::RumbleAsset::RumbleAsset(const uint8_t* _data, size_t _size):
+  data(_data),
+  size(_size) {
+  parse();
+};
+
+Joytime::RumbleAsset::RumbleAsset(Joytime::RumbleAsset&& other) noexcept {
+  *this = std::move(other);
+};
+
+Joytime::RumbleAsset& Joytime::RumbleAsset::operator=(Joytime::RumbleAsset&& other) noexcept {
+  if (this == &other) return *this;
+
+  unmap();
+
+  // moving a vector keeps its buffer, so `data` stays valid
+  owned = std::move(other.owned);
+  data = other.data;
+  size = other.size;
+  mapping = other.mapping;
+  mappingSize = other.mappingSize;
+  channelCount = other.channelCount;
+  count = other.count;
+  interval = other.interval;
+
+  other.data = nullptr;
+  other.size = 0;
+  other.mapping = nullptr;
+  other.mappingSize = 0;
+  other.count = 0;
+
+  return *this;
+};
+
+Joytime::RumbleAsset::~RumbleAsset() {
+  unmap();
+};
+
+void Joytime::RumbleAsset::unmap() {
+  if (mapping == nullptr) return;
+
+#ifdef _WIN32
+  UnmapViewOfFile(mapping);
+#else
+  munmap(mapping, mappingSize);
+#endif
+
+  mapping = nullptr;
+  mappingSize = 0;
+};
+
+void Joytime::RumbleAsset::parse() {
+  if (size < headerSize || memcmp(data, assetMagic, sizeof(assetMagic)) != 0) throw std::runtime_error("Could not load rumble asset: not a rumble asset.");
+  if (readU16(data + 4) != version) throw std::runtime_error("Could not load rumble asset: unsupported version.");
+
+  channelCount = readU16(data + 6);
+  count = readU32(data + 8);
+  interval = readU32(data + 12);
+
+  if (channelCount != 1 && channelCount != 2) throw std::runtime_error("Could not load rumble asset: invalid channel count.");
+  if ((size - headerSize) / 4 / channelCount < count) throw std::runtime_error("Could not load rumble asset: the file is truncated.");
+};
+
+Joytime::RumbleAsset Joytime::RumbleAsset::open(const char* path) {
+  Joytime::RumbleAsset asset;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("Could not load rumble asset: the file could not be opened.");
+
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+    CloseHandle(file);
+    throw std::runtime_error("Could not load rumble asset: not a rumble asset.");
+  }
+
+  HANDLE mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mappingHandle == NULL) throw std::runtime_error("Could not load rumble asset: the file could not be mapped.");
+
+  void* mapped = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+  // the view keeps the mapping alive
+  CloseHandle(mappingHandle);
+  if (mapped == NULL) throw std::runtime_error("Could not load rumble asset: the file could not be mapped.");
+
+  asset.mappingSize = (size_t)fileSize.QuadPart;
+#else
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) throw std::runtime_error("Could not load rumble asset: the file could not be opened.");
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    throw std::runtime_error("Could not load rumble asset: not a rumble asset.");
+  }
+
+  void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the file is closed
+  close(fd);
+  if (mapped == MAP_FAILED) throw std::runtime_error("Could not load rumble asset: the file could not be mapped.");
+
+  asset.mappingSize = info.st_size;
+#endif
+
+  asset.mapping = mapped;
+  asset.data = (const uint8_t*)mapped;
+  asset.size = asset.mappingSize;
+  // unmaps the file if it isn't valid
+  asset.parse();
+
+  return asset;
+};
+
+Joytime::RumbleAsset Joytime::RumbleAsset::bake(const Joytime::RumbleSample* samples, size_t frameCount, uint16_t channels, uint32_t frameInterval) {
+  if (channels != 1 && channels != 2) throw std::runtime_error("Could not bake rumble asset: invalid channel count.");
+  if (frameCount > UINT32_MAX) throw std::runtime_error("Could not bake rumble asset: too many frames.");
+
+  Joytime::RumbleAsset asset;
+  asset.owned.resize(headerSize + frameCount * channels * 4);
+
+  uint8_t* out = asset.owned.data();
+  memcpy(out, assetMagic, sizeof(assetMagic));
+  writeU16(out + 4, version);
+  writeU16(out + 6, channels);
+  writeU32(out + 8, (uint32_t)frameCount);
+  writeU32(out + 12, frameInterval);
+
+  Joytime::Rumble::encode(samples, frameCount * channels, out + headerSize);
+
+  asset.data = asset.owned.data();
+  asset.size = asset.owned.size();
+  asset.parse();
+
+  return asset;
+};
+
+void Joytime::RumbleAsset::save(const char* path) const {
+  FILE* file = fopen(path, "wb");
+  if (file == nullptr) throw std::runtime_error("Could not save rumble asset: the file could not be opened.");
+
+  size_t written = fwrite(data, 1, size, file);
+  if (fclose(file) != 0 || written != size) throw std::runtime_error("Could not save rumble asset: the file could not be written.");
+};
+
+uint16_t Joytime::RumbleAsset::channels() const {
+  return channelCount;
+};
+
+uint32_t Joytime::RumbleAsset::frameCount() const {
+  return count;
+};
+
+uint32_t Joytime::RumbleAsset::frameInterval() const {
+  return interval;
+};
+
+const uint8_t* Joytime::RumbleAsset::frame(uint32_t index, int side) const {
+  if (index >= count || (side != 0 && side != 1)) return nullptr;
+  return data + headerSize + ((size_t)index * channelCount + (channelCount == 2 ? side : 0)) * 4;
+};
+
+const uint8_t* Joytime::RumbleAsset::bytes() const {
+  return data;
+};
+
+size_t Joytime::RumbleAsset::byteSize() const {
+  return size;
+};
+
+void Joytime::RumblePlayer::play(const Joytime::RumbleAsset& _asset, bool _loop) {
+  asset = &_asset;
+  loop = _loop;
+  startedAt = std::chrono::steady_clock::now();
+  frameSent = false;
+  stopPending = false;
+};
+
+void Joytime::RumblePlayer::stop() {
+  if (asset != nullptr) stopPending = true;
+  asset = nullptr;
+};
+
+bool Joytime::RumblePlayer::playing() const {
+  return asset != nullptr;
+};
+
+bool Joytime::RumblePlayer::update(Joytime::Controller* controller, uint8_t timing) {
+  if (asset != nullptr && asset->frameCount() > 0) {
+    std::chrono::microseconds interval(std::max(asset->frameInterval(), (uint32_t)1));
+    uint64_t index = (std::chrono::steady_clock::now() - startedAt) / interval;
+
+    if (index >= asset->frameCount() && loop) {
+      uint64_t loops = index / asset->frameCount();
+      startedAt += interval * (loops * asset->frameCount());
+      index -= loops * asset->frameCount();
+    }
+
+    if (index < asset->frameCount()) {
+      if (!frameSent || index != sentFrame) {
+        controller->rumbleEncoded(timing, asset->frame((uint32_t)index, 0), asset->frame((uint32_t)index, 1));
+        sentFrame = (uint32_t)index;
+        frameSent = true;
+      }
+      return true;
+    }
+  }
+
+  // over (or stopped)
+  if (asset != nullptr) stopPending = true;
+  asset = nullptr;
+
+  if (stopPending) {
+    controller->rumbleEncoded(timing, Joytime::neutralRumbleEncoded, Joytime::neutralRumbleEncoded);
+    stopPending = false;
+  }
+
+  return false;
+};
@@ -1,19 +1,116 @@
 #include "joytime-core.hpp"
 #include <cmath>
 #include <algorithm>
+#include <array>
+#include <cstring>
+
+// the lowest frequency that encodes to each value of round(log2(frequency / 10) * 32),
+// so encoding is a binary search instead of a log2
+static const std::array<double, 256>& frequencyThresholds() {
+  static const std::array<double, 256> thresholds = [] {
+    std::array<double, 256> table;
+    for (size_t i = 0; i < table.size(); i++) table[i] = 10.0 * std::exp2((i - 0.5) / 32.0);
+    return table;
+  }();
+  return thresholds;
+};
 
-double encodeFrequency(double frequency) {
-  return round(log2(frequency / 10.0) * 32.0);
+static int encodeFrequency(double frequency) {
+  const std::array<double, 256>& thresholds = frequencyThresholds();
+  return (int)(std::upper_bound(thresholds.begin(), thresholds.end(), frequency) - thresholds.begin()) - 1;
 };
 
-double encodeAmplitude(double amplitude) {
+// the amplitude encoding as documented; slow, so it's only used to build the table below
+static double amplitudeFormula(double amplitude) {
   double preEncode = (log2(amplitude * 1000) * 32) - 0x60;
   double ret = 0;
   if (amplitude == 0) return 0;
   if (amplitude < 0.117) ret = (preEncode / (5 - pow(2, amplitude))) - 1;
   if (amplitude >= 0.117 && amplitude < 0.23) ret = preEncode - 0x5c;
   if (amplitude >= 0.23) ret = (preEncode * 2) - 0xf6;
-  return round(ret);
+  // very small amplitudes come out negative
+  return std::max(round(ret), 0.0);
+};
+
+// the lowest amplitude that encodes to each value of `amplitudeFormula` (or more, since
+// some values are skipped), so encoding is a binary search instead of a log2 and a pow.
+// `amplitudeFormula` never decreases as the amplitude grows, so each one is found by bisection
+static const std::array<double, 256>& amplitudeThresholds() {
+  static const std::array<double, 256> thresholds = [] {
+    std::array<double, 256> table;
+    table[0] = 0;
+    for (size_t i = 1; i < table.size(); i++) {
+      double low = 0;
+      double high = 1.8;
+      if (amplitudeFormula(high) < i) {
+        // never reached
+        table[i] = INFINITY;
+        continue;
+      }
+      while (true) {
+        double middle = low + (high - low) / 2;
+        if (middle <= low || middle >= high) break;
+        if (amplitudeFormula(middle) >= i) {
+          high = middle;
+        } else {
+          low = middle;
+        }
+      }
+      table[i] = high;
+    }
+    return table;
+  }();
+  return thresholds;
+};
+
+// a binary search over the thresholds is slower than the formula it replaces, so the
+// search is narrowed first: amplitudes are bucketed by their exponent and top mantissa
+// bits (a cheap log2), and each bucket starts at the value its lowest amplitude encodes to.
+// from there, at most a step or two are left
+static const int amplitudeBucketBits = 6;
+// amplitudes below 2^-10 all encode to 0
+static const int amplitudeMinimumExponent = -10;
+static const size_t amplitudeBucketCount = (size_t)(1 - amplitudeMinimumExponent) << amplitudeBucketBits;
+
+static uint64_t amplitudeBits(double amplitude) {
+  uint64_t bits;
+  memcpy(&bits, &amplitude, sizeof(bits));
+  return bits;
+};
+
+// the bucket of a positive amplitude of at least 2^-10 and less than 2
+static size_t amplitudeBucket(double amplitude) {
+  static const uint64_t firstBucket = (uint64_t)(1023 + amplitudeMinimumExponent) << amplitudeBucketBits;
+  return (amplitudeBits(amplitude) >> (52 - amplitudeBucketBits)) - firstBucket;
+};
+
+static const std::array<uint8_t, amplitudeBucketCount>& amplitudeBuckets() {
+  static const std::array<uint8_t, amplitudeBucketCount> buckets = [] {
+    const std::array<double, 256>& thresholds = amplitudeThresholds();
+    std::array<uint8_t, amplitudeBucketCount> table;
+    for (size_t i = 0; i < table.size(); i++) {
+      // the lowest amplitude in the bucket
+      double lowest = std::ldexp(1.0 + (double)(i & ((1 << amplitudeBucketBits) - 1)) / (1 << amplitudeBucketBits), (int)(i >> amplitudeBucketBits) + amplitudeMinimumExponent);
+      table[i] = (uint8_t)((std::upper_bound(thresholds.begin() + 1, thresholds.end(), lowest) - thresholds.begin()) - 1);
+    }
+    return table;
+  }();
+  return buckets;
+};
+
+// `amplitude` is clamped to 0-1.8 already
+static uint8_t encodeAmplitude(double amplitude) {
+  if (amplitude < std::ldexp(1.0, amplitudeMinimumExponent)) return 0;
+
+  const std::array<double, 256>& thresholds = amplitudeThresholds();
+  uint8_t encoded = amplitudeBuckets()[amplitudeBucket(amplitude)];
+  while (amplitude >= thresholds[encoded + 1]) encoded++;
+  return encoded;
+};
+
+static void encodeFrame(uint16_t highFrequency, uint8_t highAmplitude, uint8_t lowFrequency, uint16_t lowAmplitude, uint8_t* frame) {
+  Joytime::EncodedRumble encoded = Joytime::Rumble(highFrequency, highAmplitude, lowFrequency, lowAmplitude).encoded();
+  memcpy(frame, encoded.data(), encoded.size());
 };
 
 Joytime::Rumble::Rumble(double frequency, double amplitude):
@@ -28,44 +125,38 @@ Joytime::Rumble::Rumble(double high_frequency, double high_amplitude, double low
   highAmplitude(Rumble::amplitudeToHA(high_amplitude)),
   lowAmplitude(Rumble::amplitudeToLA(low_amplitude)) {};
 
-Joytime::Rumble::Rumble(uint16_t hf, uint8_t hf_amp, uint8_t lf, uint16_t lf_amp):
-  highFrequency(hf),
-  lowFrequency(lf),
-  highAmplitude(hf_amp),
-  lowAmplitude(lf_amp) {};
-
 uint8_t* Joytime::Rumble::toBuffer() {
-  uint8_t buf[4] = {
-    highFrequency & 0xff, // high frequency upper byte
-    highAmplitude + ((highFrequency >> 8) & 0xff), // high frequency amplitude + high frequency lower byte
-    lowFrequency + ((lowAmplitude >> 8) & 0xff), // low frequency + low frequency amplitude lower byte
-    lowAmplitude & 0xff, // low frequency upper byte
-  };
+  buffer = encoded();
 
-  return buf;
+  return buffer.data();
 };
 
 std::vector<uint8_t> Joytime::Rumble::toVector() {
-  std::vector<uint8_t> buf = {
-    (uint8_t)(highFrequency & 0xff), // high frequency upper byte
-    (uint8_t)(highAmplitude + ((highFrequency >> 8) & 0xff)), // high frequency amplitude + high frequency lower byte
-    (uint8_t)(lowFrequency + ((lowAmplitude >> 8) & 0xff)), // low frequency + low frequency amplitude lower byte
-    (uint8_t)(lowAmplitude & 0xff), // low frequency upper byte
-  };
+  std::vector<uint8_t> buf(4);
+  encodeFrame(highFrequency, highAmplitude, lowFrequency, lowAmplitude, buf.data());
 
   return buf;
 };
 
+void Joytime::Rumble::encode(const Joytime::RumbleSample* samples, size_t count, uint8_t* frames) {
+  for (size_t i = 0; i < count; i++) {
+    const Joytime::RumbleSample& sample = samples[i];
+    encodeFrame(frequencyToHF(sample.highFrequency), amplitudeToHA(sample.highAmplitude), frequencyToLF(sample.lowFrequency), amplitudeToLA(sample.lowAmplitude), frames + i * 4);
+  }
+};
+
 uint16_t Joytime::Rumble::frequencyToHF(double frequency) {
   frequency = std::clamp(frequency, 0.0, 1253.0);
 
-  return (encodeFrequency(frequency) - 0x60) * 4;
+  // 0x00-0x1fc
+  return (std::clamp(encodeFrequency(frequency), 0x60, 0xdf) - 0x60) * 4;
 };
 
 uint8_t Joytime::Rumble::frequencyToLF(double frequency) {
   frequency = std::clamp(frequency, 0.0, 1253.0);
 
-  return (encodeFrequency(frequency) * 32.0) - 0x40;
+  // 0x01-0x7f
+  return std::clamp(encodeFrequency(frequency), 0x41, 0xbf) - 0x40;
 };
 
 uint8_t Joytime::Rumble::amplitudeToHA(double amplitude) {
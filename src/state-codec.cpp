@@ -0,0 +1,252 @@
+#include "joytime-core.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// changed-field flags
+static const uint8_t fieldButtons = 0x01;
+static const uint8_t fieldSticks = 0x02;
+static const uint8_t fieldAccelerometer = 0x04;
+static const uint8_t fieldGyroscope = 0x08;
+static const uint8_t fieldTimer = 0x10;
+static const uint8_t fieldBattery = 0x20;
+
+static const int stickShift = 2;
+static const double accelerometerScale = 4096.0;
+static const double gyroscopeScale = 16.0;
+
+static int16_t quantize(double value, double scale) {
+  double scaled = std::round(value * scale);
+  if (scaled > INT16_MAX) return INT16_MAX;
+  if (scaled < INT16_MIN) return INT16_MIN;
+  return (int16_t)scaled;
+};
+
+Joytime::QuantizedControllerState Joytime::QuantizedControllerState::fromState(const Joytime::ControllerState& state) {
+  Joytime::QuantizedControllerState quantized;
+
+  quantized.sequence = state.sequence;
+  quantized.timer = state.timer;
+  quantized.battery = (uint8_t)state.battery;
+  quantized.buttons = Joytime::packButtons(state.buttons);
+
+  // arithmetic shift, so negative values round towards negative infinity
+  quantized.sticks[0] = state.leftStick.x >> stickShift;
+  quantized.sticks[1] = state.leftStick.y >> stickShift;
+  quantized.sticks[2] = state.rightStick.x >> stickShift;
+  quantized.sticks[3] = state.rightStick.y >> stickShift;
+
+  quantized.accelerometer[0] = quantize(state.accelerometer.x, accelerometerScale);
+  quantized.accelerometer[1] = quantize(state.accelerometer.y, accelerometerScale);
+  quantized.accelerometer[2] = quantize(state.accelerometer.z, accelerometerScale);
+
+  quantized.gyroscope[0] = quantize(state.gyroscope.x, gyroscopeScale);
+  quantized.gyroscope[1] = quantize(state.gyroscope.y, gyroscopeScale);
+  quantized.gyroscope[2] = quantize(state.gyroscope.z, gyroscopeScale);
+
+  return quantized;
+};
+
+Joytime::ControllerState Joytime::QuantizedControllerState::toState() const {
+  Joytime::ControllerState state;
+
+  state.sequence = sequence;
+  state.timer = timer;
+  state.battery = (Joytime::ControllerBatteryStatus)battery;
+  state.buttons = Joytime::unpackButtons(buttons);
+
+  state.leftStick.x = sticks[0] * (1 << stickShift);
+  state.leftStick.y = sticks[1] * (1 << stickShift);
+  state.rightStick.x = sticks[2] * (1 << stickShift);
+  state.rightStick.y = sticks[3] * (1 << stickShift);
+
+  state.accelerometer.x = accelerometer[0] / accelerometerScale;
+  state.accelerometer.y = accelerometer[1] / accelerometerScale;
+  state.accelerometer.z = accelerometer[2] / accelerometerScale;
+
+  state.gyroscope.x = gyroscope[0] / gyroscopeScale;
+  state.gyroscope.y = gyroscope[1] / gyroscopeScale;
+  state.gyroscope.z = gyroscope[2] / gyroscopeScale;
+
+  return state;
+};
+
+// LEB128-style varints, with zigzag encoding for signed values
+
+static uint8_t* writeVarint(uint8_t* out, uint64_t value) {
+  while (value >= 0x80) {
+    *out++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *out++ = (uint8_t)value;
+  return out;
+};
+
+static uint8_t* writeSigned(uint8_t* out, int64_t value) {
+  return writeVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+};
+
+static bool readVarint(const uint8_t*& in, const uint8_t* end, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (in == end) return false;
+    uint8_t byte = *in++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return true;
+  }
+  return false;
+};
+
+static bool readSigned(const uint8_t*& in, const uint8_t* end, int64_t& value) {
+  uint64_t raw;
+  if (!readVarint(in, end, raw)) return false;
+  value = (int64_t)(raw >> 1) ^ -(int64_t)(raw & 1);
+  return true;
+};
+
+static const size_t historySize = 64;
+
+size_t Joytime::StateDeltaEncoder::encode(const Joytime::ControllerState& state, uint8_t* buffer, size_t capacity) {
+  if (capacity < maxFrameSize) return 0;
+
+  Joytime::QuantizedControllerState current = Joytime::QuantizedControllerState::fromState(state);
+
+  // frame numbers start at 1; 0 means "no base"
+  frame++;
+  if (frame == 0) frame = 1;
+
+  Joytime::QuantizedControllerState zero;
+  const Joytime::QuantizedControllerState* base = &zero;
+  uint32_t baseFrame = 0;
+  if (acknowledged != 0 && historyFrames[acknowledged % historySize] == acknowledged) {
+    base = &history[acknowledged % historySize];
+    baseFrame = acknowledged;
+  }
+
+  uint8_t fields = 0;
+  if (current.buttons != base->buttons) fields |= fieldButtons;
+  if (memcmp(current.sticks, base->sticks, sizeof(current.sticks)) != 0) fields |= fieldSticks;
+  if (memcmp(current.accelerometer, base->accelerometer, sizeof(current.accelerometer)) != 0) fields |= fieldAccelerometer;
+  if (memcmp(current.gyroscope, base->gyroscope, sizeof(current.gyroscope)) != 0) fields |= fieldGyroscope;
+  if (current.timer != base->timer) fields |= fieldTimer;
+  if (current.battery != base->battery) fields |= fieldBattery;
+
+  uint8_t* out = buffer;
+  *out++ = version;
+  out = writeVarint(out, frame);
+  out = writeVarint(out, baseFrame);
+  *out++ = fields;
+  out = writeSigned(out, (int64_t)(current.sequence - base->sequence));
+
+  if (fields & fieldButtons) out = writeVarint(out, current.buttons ^ base->buttons);
+  if (fields & fieldSticks) {
+    for (int i = 0; i < 4; i++) out = writeSigned(out, current.sticks[i] - base->sticks[i]);
+  }
+  if (fields & fieldAccelerometer) {
+    for (int i = 0; i < 3; i++) out = writeSigned(out, current.accelerometer[i] - base->accelerometer[i]);
+  }
+  if (fields & fieldGyroscope) {
+    for (int i = 0; i < 3; i++) out = writeSigned(out, current.gyroscope[i] - base->gyroscope[i]);
+  }
+  if (fields & fieldTimer) *out++ = current.timer;
+  if (fields & fieldBattery) *out++ = current.battery;
+
+  history[frame % historySize] = current;
+  historyFrames[frame % historySize] = frame;
+
+  return out - buffer;
+};
+
+void Joytime::StateDeltaEncoder::acknowledge(uint32_t _frame) {
+  if (_frame == 0 || historyFrames[_frame % historySize] != _frame) return;
+  // acknowledgements can arrive out of order; only move forward
+  if (acknowledged != 0 && (int32_t)(_frame - acknowledged) <= 0) return;
+  acknowledged = _frame;
+};
+
+void Joytime::StateDeltaEncoder::reset() {
+  acknowledged = 0;
+};
+
+bool Joytime::StateDeltaDecoder::decode(const uint8_t* data, size_t size, Joytime::ControllerState& state) {
+  const uint8_t* in = data;
+  const uint8_t* end = data + size;
+
+  if (in == end || *in++ != Joytime::StateDeltaEncoder::version) return false;
+
+  uint64_t frame;
+  uint64_t baseFrame;
+  if (!readVarint(in, end, frame) || !readVarint(in, end, baseFrame)) return false;
+  if (frame == 0 || frame > UINT32_MAX || baseFrame > UINT32_MAX) return false;
+
+  Joytime::QuantizedControllerState zero;
+  const Joytime::QuantizedControllerState* base = &zero;
+  if (baseFrame != 0) {
+    if (historyFrames[baseFrame % historySize] != baseFrame) return false;
+    base = &history[baseFrame % historySize];
+  }
+
+  if (in == end) return false;
+  uint8_t fields = *in++;
+
+  Joytime::QuantizedControllerState current = *base;
+  int64_t delta;
+  uint64_t value;
+
+  if (!readSigned(in, end, delta)) return false;
+  current.sequence = base->sequence + delta;
+
+  if (fields & fieldButtons) {
+    if (!readVarint(in, end, value)) return false;
+    current.buttons = base->buttons ^ (uint32_t)value;
+  }
+  if (fields & fieldSticks) {
+    for (int i = 0; i < 4; i++) {
+      if (!readSigned(in, end, delta)) return false;
+      current.sticks[i] = (int16_t)(base->sticks[i] + delta);
+    }
+  }
+  if (fields & fieldAccelerometer) {
+    for (int i = 0; i < 3; i++) {
+      if (!readSigned(in, end, delta)) return false;
+      current.accelerometer[i] = (int16_t)(base->accelerometer[i] + delta);
+    }
+  }
+  if (fields & fieldGyroscope) {
+    for (int i = 0; i < 3; i++) {
+      if (!readSigned(in, end, delta)) return false;
+      current.gyroscope[i] = (int16_t)(base->gyroscope[i] + delta);
+    }
+  }
+  if (fields & fieldTimer) {
+    if (in == end) return false;
+    current.timer = *in++;
+  }
+  if (fields & fieldBattery) {
+    if (in == end) return false;
+    current.battery = *in++;
+  }
+
+  history[frame % historySize] = current;
+  historyFrames[frame % historySize] = (uint32_t)frame;
+  latest = (uint32_t)frame;
+
+  state = current.toState();
+  return true;
+};
+
+uint32_t Joytime::StateDeltaDecoder::lastFrame() const {
+  return latest;
+};
+
+void Joytime::StateDeltaDecoder::reset() {
+  memset(historyFrames, 0, sizeof(historyFrames));
+  latest = 0;
+};
+
+bool Joytime::StateDeltaLoopback::transfer(const Joytime::ControllerState& in, Joytime::ControllerState& out, bool acknowledge) {
+  lastFrameSize = encoder.encode(in, buffer, sizeof(buffer));
+  if (!decoder.decode(buffer, lastFrameSize, out)) return false;
+  if (acknowledge) encoder.acknowledge(decoder.lastFrame());
+  return true;
+};
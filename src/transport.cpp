@@ -0,0 +1,91 @@
+#include "joytime-core.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// how many bytes the callback-based transports ask for on each read, at most
+static const size_t callbackReadSize = 50;
+
+Joytime::Transport::~Transport() {};
+
+size_t Joytime::Transport::sendBatch(const Joytime::ConstPacketView* packets, size_t count) {
+  size_t sent = 0;
+  for (; sent < count; sent++) {
+    if (send(packets[sent].data, packets[sent].size) < 0) break;
+  }
+  return sent;
+};
+
+size_t Joytime::Transport::receiveBatch(Joytime::PacketView* packets, size_t count, int timeout) {
+  size_t received = 0;
+  for (; received < count; received++) {
+    // only wait for the first packet, just drain whatever's queued after that
+    int bytesRead = receive(packets[received].data, packets[received].size, (received == 0) ? timeout : 0);
+    if (bytesRead <= 0) break;
+    packets[received].size = bytesRead;
+  }
+  return received;
+};
+
+int Joytime::Transport::readFD() const {
+  return -1;
+};
+
+int Joytime::Transport::writeFD() const {
+  return -1;
+};
+
+Joytime::CallbackTransport::CallbackTransport(void* _handle, Joytime::TransmitBufferFunction* _transmitBuffer, Joytime::ReceiveBufferFunction* _receiveBuffer):
+  handle(_handle),
+  transmitBuffer(_transmitBuffer),
+  receiveBuffer(_receiveBuffer) {};
+
+Joytime::CallbackTransport::CallbackTransport(void* _handle, Joytime::CTransmitBufferFunction* _transmitBufferC, Joytime::CReceiveBufferFunction* _receiveBufferC):
+  handle(_handle),
+  transmitBufferC(_transmitBufferC),
+  receiveBufferC(_receiveBufferC) {};
+
+int Joytime::CallbackTransport::send(const uint8_t* data, size_t size) {
+  if (transmitBuffer != nullptr) {
+    // the C++ callbacks take their buffer by value, so this path has to copy
+    transmitBuffer(handle, std::vector<uint8_t>(data, data + size));
+  } else if (transmitBufferC != nullptr) {
+    transmitBufferC(handle, (uint8_t*)data, size);
+  } else {
+    return -1;
+  }
+
+  return size;
+};
+
+int Joytime::CallbackTransport::receive(uint8_t* data, size_t capacity, int timeout) {
+  // the callbacks have no notion of a timeout; they're read until they come up empty
+  // or the buffer is full. whatever doesn't fit is left for the next call
+  size_t received = 0;
+
+  if (receiveBuffer != nullptr) {
+    while (received < capacity) {
+      std::vector<uint8_t> tmp = receiveBuffer(handle, std::min(callbackReadSize, capacity - received));
+      if (tmp.size() == 0) break;
+
+      size_t bytesToCopy = std::min(tmp.size(), capacity - received);
+      memcpy(data + received, tmp.data(), bytesToCopy);
+      received += bytesToCopy;
+    }
+  } else if (receiveBufferC != nullptr) {
+    while (received < capacity) {
+      int bytesRead = 0;
+      uint8_t* tmp = receiveBufferC(handle, std::min(callbackReadSize, capacity - received), &bytesRead);
+      if (bytesRead <= 0) break;
+
+      size_t bytesToCopy = std::min((size_t)bytesRead, capacity - received);
+      memcpy(data + received, tmp, bytesToCopy);
+      received += bytesToCopy;
+    }
+  } else {
+    return -1;
+  }
+
+  return received;
+};